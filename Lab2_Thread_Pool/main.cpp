@@ -23,28 +23,28 @@ void foo() {
 	std::cout << "thread id: " << std::this_thread::get_id() << "; \tfoo();         \ttook " << sleep_seconds << "s \n";
 }
 
-//void boo(int a) {
-//	const int sleep_seconds = uniDist(randGen);
-//	std::this_thread::sleep_for(seconds(sleep_seconds));
-//
-//	write_lock w_lock(out_mutex);
-//	std::cout << "thread id: " << std::this_thread::get_id() << "; \tboo(int);      \ta = " << a << "; \ttook " << sleep_seconds << "s \n";
-//}
-//
-//int roo(int a, int b) {
-//	const int sleep_seconds = uniDist(randGen);
-//	std::this_thread::sleep_for(seconds(sleep_seconds));
-//
-//	write_lock w_lock(out_mutex);
-//	std::cout << "thread id: " << std::this_thread::get_id() << "; \troo(int, int); \ta = " << a << ";  b = " << b << "; \ttook " << sleep_seconds << "s \n";
-//	return a;
-//}
+void boo(int a) {
+	const int sleep_seconds = uniDist(randGen);
+	std::this_thread::sleep_for(seconds(sleep_seconds));
+
+	write_lock w_lock(out_mutex);
+	std::cout << "thread id: " << std::this_thread::get_id() << "; \tboo(int);      \ta = " << a << "; \ttook " << sleep_seconds << "s \n";
+}
+
+int roo(int a, int b) {
+	const int sleep_seconds = uniDist(randGen);
+	std::this_thread::sleep_for(seconds(sleep_seconds));
+
+	write_lock w_lock(out_mutex);
+	std::cout << "thread id: " << std::this_thread::get_id() << "; \troo(int, int); \ta = " << a << ";  b = " << b << "; \ttook " << sleep_seconds << "s \n";
+	return a;
+}
 
 int main(int argc, char* argv[]) {
 	constexpr std::size_t worker_thread_count = 2;
 	constexpr std::size_t tp_interval_seconds = 10;
 
-	thread_pool<true> tp(tp_interval_seconds);
+	phased_thread_pool<true, true, tp_interval_seconds> tp;
 	tp.initialize(worker_thread_count);
 
 	std::vector<std::thread> add_task_threads(10);
@@ -58,12 +58,27 @@ int main(int argc, char* argv[]) {
 	for (int i = 0; i < 5; ++i) {
 		tp.add_task(foo);
 	}
+
+	tp.add_task(boo, 1);
+	task_future<int> roo_result = tp.submit(roo, 2, 3);
 	
+	try {
+		const int a = roo_result.get();
+
+		write_lock w_lock(out_mutex);
+		std::cout << "roo(2, 3) returned " << a << "\n";
+	}
+	catch (const std::exception& exception) {
+		write_lock w_lock(out_mutex);
+		std::cout << "roo(2, 3) was not completed: " << exception.what() << "\n";
+	}
+
 	std::this_thread::sleep_for(seconds(15));
 	for (int i = 0; i < 10; ++i) {
 		tp.add_task(foo);
 	}
-	std::this_thread::sleep_for(seconds(30));
+	// Returns as soon as the last of these tasks is done instead of sleeping for a guessed amount of time.
+	tp.wait_idle();
 	tp.terminate();
 	
 	std::for_each(add_task_threads.begin(), add_task_threads.end(), std::mem_fn(&std::thread::join));
@@ -1,155 +1,109 @@
 #pragma once
 
-#include <thread>
 #include <vector>
-#include <queue>
 #include <atomic>
 #include <mutex>
+#include <algorithm>
+#include <functional>
+
+#include "parallel_algorithms.h"
+#include "top_k.h"
+#include "concurrent_top_k.h"
 
 // ===== Atomic algorithm =====
 
-template <typename T>
-inline void resursive_change_max_atomic(const T& desired, const std::size_t start_from_index, const std::size_t elem_num, std::vector<std::atomic<T>>& vec_of_max_atomics) {
-	for (std::size_t i = start_from_index; i < elem_num; ++i) {
-		T contained = vec_of_max_atomics[i].load();
-		bool changed = true;
-
-		if (desired > contained) {
-			while (!vec_of_max_atomics[i].compare_exchange_weak(contained, desired)) {
-				if (desired <= contained) {
-					changed = false;
-					break;
-				}
-			}
-
-			resursive_change_max_atomic((changed ? contained : desired), i + 1, elem_num, vec_of_max_atomics);
-			break;
-		}
-	}
+// Find elem_num max elements in the given vector range and insert them into the given concurrent top-k (max_values).
+// Only the max values of the range that beat max_values.threshold() touch its shared slots.
+template <typename T, typename iterator_t>
+inline void find_n_max_elem_in_vector_range_atomic(const iterator_t it_begin, const iterator_t it_end, concurrent_top_k<T>& max_values) {
+	max_values.insert(it_begin, it_end);
 }
 
-// Find elem_num max elements in the given vector range and store them in the given vector of atomics (vec_of_max_atomics).
+// Find elem_num max elements in the given vector and store them in the given vector of atomics (vec_of_max_atomics) in descending order.
 // The size of vec_of_max_atomics should not be less than elem_num (ideally, it should be equal according to the logic).
-// The number of elements in the given vector range should not be less than elem_num. Otherwise, it is undefined behavior.
-template <typename T>
-inline void find_n_max_elem_in_vector_range_atomic(const typename std::vector<T>::const_iterator it_begin, const typename std::vector<T>::const_iterator it_end, const std::size_t elem_num, std::vector<std::atomic<T>>& vec_of_max_atomics) {
-	// Build a priority queue from the given vector iterators using a special constructor for this. The time complexity of this method is effective - O(N).
-	std::priority_queue<T> max_heap(it_begin, it_end);
-
-	for (std::size_t i = 0; i < elem_num; ++i) {
-		T max_heap_top = max_heap.top();
-		max_heap.pop();
-
-		// A little optimization: since we pop values from a max heap, it means that the next values would not be greater then the previous ones.
-		// And because of that, no matter what result would be with vec_of_max_atomics[i] for the previous value, 
-		// for the next value it always would fail with the same vec_of_max_atomics[i] (contained value in the vec_of_max_atomics[i] is never changed).
-		// So we don't need to iterate through all the vec_of_max_atomics vector from the very start again and again, but start from vec_of_max_atomics[i].
-		resursive_change_max_atomic(max_heap_top, i, elem_num, vec_of_max_atomics);
+// If the vector has less than elem_num elements, all of them are stored.
+// The algorithm is performed by the workers of the given thread pool (and the calling thread), every task processes a chunk of the vector
+// and inserts it into one concurrent_top_k shared by all of them. Returns the counters of its slow path (CAS failures among them).
+template <typename T, typename allocator_t>
+inline concurrent_top_k_statistics find_n_max_elem_in_vector_atomic(const std::vector<T, allocator_t>& vec, const std::size_t elem_num, thread_pool& pool, std::vector<std::atomic<T>>& vec_of_max_atomics) {
+	using const_iterator = typename std::vector<T, allocator_t>::const_iterator;
+
+	concurrent_top_k<T> max_values(elem_num);
+
+	// The values already stored compete with the vector, like before.
+	for (const std::atomic<T>& stored : vec_of_max_atomics) {
+		max_values.insert(stored.load());
 	}
-}
-
-// Find elem_num max elements in the given vector and store them in the given vector of atomics (vec_of_max_atomics).
-// The size of vec_of_max_atomics should not be less than elem_num (ideally, it should be equal according to the logic).
-// The number of elements in the given vector range should not be less than elem_num. Otherwise, it is undefined behavior.
-// The algorithm is performed in thread_count threads.
-template <typename T>
-inline void find_n_max_elem_in_vector_atomic(const std::vector<T>& vec, const std::size_t elem_num, const std::size_t thread_count, std::vector<std::atomic<T>>& vec_of_max_atomics) {
-	const std::size_t vec_size = vec.size();
 
-	const std::size_t step = vec_size / thread_count;
-	const std::size_t remainder = (vec_size - step * thread_count == 0 ? 0 : vec_size - step * (thread_count - 1));
+	parallel_for(pool, vec.cbegin(), vec.cend(), elem_num, [&max_values](const const_iterator it_begin, const const_iterator it_end) {
+		find_n_max_elem_in_vector_range_atomic<T>(it_begin, it_end, max_values);
+	});
 
-	std::vector<std::thread> worker_threads(thread_count);
-
-	for (std::size_t i = 0; i < thread_count - 1; ++i) {
-		worker_threads[i] = std::thread(find_n_max_elem_in_vector_range_atomic<T>, vec.cbegin() + i * step, vec.cbegin() + (i + 1) * step, elem_num, std::ref(vec_of_max_atomics));
+	const std::vector<T> descending_max_values = max_values.values_descending();
+	for (std::size_t i = 0; i < descending_max_values.size(); ++i) {
+		vec_of_max_atomics[i] = descending_max_values[i];
 	}
-	worker_threads[thread_count - 1] = std::thread(find_n_max_elem_in_vector_range_atomic<T>, vec.cend() - (remainder == 0 ? step : remainder), vec.cend(), elem_num, std::ref(vec_of_max_atomics));
 
-	for (auto& worker_thread : worker_threads) {
-		worker_thread.join();
-	}
+	return max_values.statistics();
 }
 
 // ===== Mutex algorithm =====
 
-template <typename T>
-inline void resursive_change_max_mutex(const T& desired, const std::size_t start_from_index, const std::size_t elem_num, std::vector<T>& vec_of_max_values, std::mutex& max_values_mutex) {
-	max_values_mutex.lock();
-
-	for (std::size_t i = start_from_index; i < elem_num; ++i) {
-		T max_value = vec_of_max_values[i];
-
-		if (desired > max_value) {
-			vec_of_max_values[i] = desired;
-		
-			max_values_mutex.unlock();
-			resursive_change_max_mutex(max_value, i + 1, elem_num, vec_of_max_values, max_values_mutex);
-	
-			return;
-		}
-	}
+// Find elem_num max elements in the given vector range and merge them into the given vector of max values (vec_of_max_values).
+// vec_of_max_values is kept in descending order (so it should be sorted like that from the start, e.g. filled with the lowest value),
+// and its size should not be less than elem_num. If the range has less than elem_num elements, all of them are merged.
+// The max values of the range are found before locking, and the mutex is locked once per range.
+template <typename T, typename iterator_t>
+inline void find_n_max_elem_in_vector_range_mutex(const iterator_t it_begin, const iterator_t it_end, const std::size_t elem_num, std::vector<T>& vec_of_max_values, std::mutex& max_values_mutex) {
+	// One pass over the range keeping only the elem_num max values of it (the range itself is not copied).
+	top_k_values<T> range_max_values(elem_num);
+	range_max_values.push(it_begin, it_end);
+	const std::vector<T> descending_max_values = range_max_values.take_sorted();
 
-	max_values_mutex.unlock();
-}
+	std::vector<T> merged(elem_num + descending_max_values.size());
 
-// Find elem_num max elements in the given vector range and store them in the given vector of max values (vec_of_max_values).
-// The size of vec_of_max_values should not be less than elem_num (ideally, it should be equal according to the logic).
-// The number of elements in the given vector range should not be less than elem_num. Otherwise, it is undefined behavior.
-template <typename T>
-inline void find_n_max_elem_in_vector_range_mutex(const typename std::vector<T>::const_iterator it_begin, const typename std::vector<T>::const_iterator it_end, const std::size_t elem_num, std::vector<T>& vec_of_max_values, std::mutex& max_values_mutex) {
-	// Build a priority queue from the given vector iterators using a special constructor for this. The time complexity of this method is effective - O(N).
-	std::priority_queue<T> max_heap(it_begin, it_end);
-
-	for (std::size_t i = 0; i < elem_num; ++i) {
-		T max_heap_top = max_heap.top();
-		max_heap.pop();
-
-		// A little optimization: since we pop values from a max heap, it means that the next values would not be greater then the previous ones.
-		// And because of that, no matter what result would be with vec_of_max_values[i] for the previous value, 
-		// for the next value it always would fail with the same vec_of_max_values[i] (contained value in the vec_of_max_values[i] is never changed).
-		// So we don't need to iterate through all the vec_of_max_values vector from the very start again and again, but start from vec_of_max_values[i].
-		resursive_change_max_mutex(max_heap_top, i, elem_num, vec_of_max_values, max_values_mutex);
-	}
+	std::lock_guard<std::mutex> lock(max_values_mutex);
+
+	std::merge(vec_of_max_values.begin(), vec_of_max_values.begin() + elem_num, descending_max_values.begin(), descending_max_values.end(), merged.begin(), std::greater<T>());
+	std::copy(merged.begin(), merged.begin() + elem_num, vec_of_max_values.begin());
 }
 
 // Find elem_num max elements in the given vector and store them in the given vector of max values (vec_of_max_values).
 // The size of vec_of_max_values should not be less than elem_num (ideally, it should be equal according to the logic).
-// The number of elements in the given vector range should not be less than elem_num. Otherwise, it is undefined behavior.
-// The algorithm is performed in thread_count threads.
-template <typename T>
-inline void find_n_max_elem_in_vector_mutex(const std::vector<T>& vec, const std::size_t elem_num, const std::size_t thread_count, std::vector<T>& vec_of_max_values, std::mutex& max_values_mutex) {
-	const std::size_t vec_size = vec.size();
-
-	const std::size_t step = vec_size / thread_count;
-	const std::size_t remainder = (vec_size - step * thread_count == 0 ? 0 : vec_size - step * (thread_count - 1));
+// If the vector has less than elem_num elements, all of them are stored.
+// The algorithm is performed by the workers of the given thread pool (and the calling thread), every task processes a chunk of the vector.
+template <typename T, typename allocator_t>
+inline void find_n_max_elem_in_vector_mutex(const std::vector<T, allocator_t>& vec, const std::size_t elem_num, thread_pool& pool, std::vector<T>& vec_of_max_values, std::mutex& max_values_mutex) {
+	using const_iterator = typename std::vector<T, allocator_t>::const_iterator;
+
+	parallel_for(pool, vec.cbegin(), vec.cend(), elem_num, [elem_num, &vec_of_max_values, &max_values_mutex](const const_iterator it_begin, const const_iterator it_end) {
+		find_n_max_elem_in_vector_range_mutex<T>(it_begin, it_end, elem_num, vec_of_max_values, max_values_mutex);
+	});
+}
 
-	std::vector<std::thread> worker_threads(thread_count);
+// ===== Reduce algorithm =====
 
-	for (std::size_t i = 0; i < thread_count - 1; ++i) {
-		worker_threads[i] = std::thread(find_n_max_elem_in_vector_range_mutex<T>, vec.cbegin() + i * step, vec.cbegin() + (i + 1) * step, elem_num, std::ref(vec_of_max_values), std::ref(max_values_mutex));
-	}
-	worker_threads[thread_count - 1] = std::thread(find_n_max_elem_in_vector_range_mutex<T>, vec.cend() - (remainder == 0 ? step : remainder), vec.cend(), elem_num, std::ref(vec_of_max_values), std::ref(max_values_mutex));
-
-	for (auto& worker_thread : worker_threads) {
-		worker_thread.join();
-	}
+// Find elem_num max elements in the given vector and store them in the given vector of max values (vec_of_max_values) in descending order.
+// The size of vec_of_max_values should not be less than elem_num (ideally, it should be equal according to the logic).
+// If the vector has less than elem_num elements, all of them are stored.
+// Every participant of parallel_reduce keeps its own elem_num max values, so nothing is shared (no atomics, no mutex) until the partial
+// results are merged at the end (see select_k). For a large elem_num (e.g. the top 1% of the vector) select_k switches to radix_select:
+// per-participant histograms of the top bits of the values instead of heaps of elem_num values.
+template <typename T, typename allocator_t>
+inline void find_n_max_elem_in_vector_reduce(const std::vector<T, allocator_t>& vec, const std::size_t elem_num, thread_pool& pool, std::vector<T>& vec_of_max_values) {
+	const std::vector<T> max_values = select_k(pool, vec, elem_num);
+	std::copy(max_values.begin(), max_values.end(), vec_of_max_values.begin());
 }
 
 // ===== Singlethreaded algorithm =====
 
 // Find elem_num max elements in the given vector and store them in the given vector of max values (vec_of_max_values).
 // The size of vec_of_max_values should not be less than elem_num (ideally, it should be equal according to the logic).
-// The number of elements in the given vector should not be less than elem_num. Otherwise, it is undefined behavior.
+// If the vector has less than elem_num elements, all of them are stored.
 // The algorithm is performed in a single thread.
-template <typename T>
-inline void find_n_max_elem_in_vector(const std::vector<T>& vec, const std::size_t elem_num, std::vector<T>& vec_of_max_values) {
-	// Build a priority queue from the given vector using a special constructor for this. The time complexity of this method is effective - O(N).
-	std::priority_queue<T> max_heap(vec.begin(), vec.end());
-
-	for (std::size_t i = 0; i < elem_num; ++i) {
-		T max_heap_top = max_heap.top();
-		max_heap.pop();
-		vec_of_max_values[i] = max_heap_top;
-	}
+template <typename T, typename allocator_t>
+inline void find_n_max_elem_in_vector(const std::vector<T, allocator_t>& vec, const std::size_t elem_num, std::vector<T>& vec_of_max_values) {
+	// One pass over the vector keeping only the elem_num max values of it (the vector itself is not copied).
+	const std::vector<T> max_values = select_k(vec, elem_num);
+	std::copy(max_values.begin(), max_values.end(), vec_of_max_values.begin());
 }
\ No newline at end of file
@@ -1,33 +1,66 @@
 #pragma once
 
-#include <thread>
 #include <vector>
 #include <random>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
 
-// Assign random generated values into the given vector range. Part of the vector initialization init_vector function.
+#include "parallel_algorithms.h"
+
+// std::allocator that leaves elements default-initialized when no value is given, so std::vector<T, first_touch_allocator<T>>(n)
+// doesn't zero the buffer. The memory pages of a large buffer are then first touched (and placed on a NUMA node) by the workers
+// that initialize them, not by the thread that creates the vector.
 template <typename T>
-inline void init_vector_range(const typename std::vector<T>::iterator it_begin, const typename std::vector<T>::iterator it_end, std::mt19937& rand_gen, std::uniform_int_distribution<T>& uni_dist) {
+class first_touch_allocator : public std::allocator<T> {
+public:
+	template <typename U>
+	struct rebind {
+		using other = first_touch_allocator<U>;
+	};
+
+	inline first_touch_allocator() noexcept = default;
+
+	template <typename U>
+	inline first_touch_allocator(const first_touch_allocator<U>&) noexcept {}
+
+	template <typename U>
+	inline void construct(U* const element) noexcept(std::is_nothrow_default_constructible_v<U>) {
+		::new (static_cast<void*>(element)) U;
+	}
+
+	template <typename U, typename... arguments>
+	inline void construct(U* const element, arguments&&... parameters) {
+		::new (static_cast<void*>(element)) U(std::forward<arguments>(parameters)...);
+	}
+};
+
+// Minimal amount of elements initialized by one task - seeding a generator for less is not worth it.
+constexpr std::size_t init_vector_grain = 16 * 1024;
+
+// Assign random generated values into the given vector range. Part of the vector initialization init_vector function.
+template <typename T, typename iterator_t>
+inline void init_vector_range(const iterator_t it_begin, const iterator_t it_end, std::mt19937& rand_gen, std::uniform_int_distribution<T>& uni_dist) {
 	std::generate(it_begin, it_end, [&]() {
 		return uni_dist(rand_gen);
 	});
 }
 
-// Initialize given vector with random values.
-template <typename T>
-inline void init_vector(std::vector<T>& vec, const std::size_t thread_count, std::mt19937& rand_gen, std::uniform_int_distribution<T>& uni_dist) {
-	const std::size_t vec_size = vec.size();
-
-	const std::size_t step = vec_size / thread_count;
-	const std::size_t remainder = (vec_size - step * thread_count == 0 ? 0 : vec_size - step * (thread_count - 1));
+// Initialize given vector with random values on the workers of the given thread pool.
+// Every chunk gets its own generator seeded from rand_gen, so the workers never share the generator state.
+// With a NUMA-placed pool every part of the vector is initialized on the node that processes it later (see thread_pool::placement_groups).
+template <typename T, typename allocator_t>
+inline void init_vector(std::vector<T, allocator_t>& vec, thread_pool& pool, std::mt19937& rand_gen, std::uniform_int_distribution<T>& uni_dist) {
+	using iterator = typename std::vector<T, allocator_t>::iterator;
 
-	std::vector<std::thread> init_vec_threads(thread_count);
+	const std::mt19937::result_type seed = rand_gen();
 
-	for (std::size_t i = 0; i < thread_count - 1; ++i) {
-		init_vec_threads[i] = std::thread(init_vector_range<T>, vec.begin() + i * step, vec.begin() + (i + 1) * step, std::ref(rand_gen), std::ref(uni_dist));
-	}
-	init_vec_threads[thread_count - 1] = std::thread(init_vector_range<T>, vec.end() - (remainder == 0 ? step : remainder), vec.end(), std::ref(rand_gen), std::ref(uni_dist));
+	parallel_for(pool, vec.begin(), vec.end(), init_vector_grain, [&vec, seed, &uni_dist](const iterator it_begin, const iterator it_end) {
+		std::seed_seq chunk_seed{ seed, static_cast<std::mt19937::result_type>(it_begin - vec.begin()) };
+		std::mt19937 chunk_rand_gen(chunk_seed);
+		std::uniform_int_distribution<T> chunk_uni_dist(uni_dist.param());
 
-	for (auto& init_vec_thread : init_vec_threads) {
-		init_vec_thread.join();
-	}
+		init_vector_range<T>(it_begin, it_end, chunk_rand_gen, chunk_uni_dist);
+	});
 }
\ No newline at end of file
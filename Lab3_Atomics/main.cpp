@@ -15,8 +15,8 @@ using std::chrono::nanoseconds;
 using std::chrono::duration_cast;
 using std::chrono::high_resolution_clock;
 
-template <typename T, typename U>
-inline void print_result_info(const std::vector<T>& vec, const std::size_t thread_count_info, const std::vector<U>& max_values, T& sum, const nanoseconds& elapsed_ns);
+template <typename T, typename allocator_t, typename U>
+inline void print_result_info(const std::vector<T, allocator_t>& vec, const std::size_t thread_count_info, const std::vector<U>& max_values, T& sum, const nanoseconds& elapsed_ns);
 
 int main(int argc, char* argv[]) {
 	using myType = int;
@@ -27,13 +27,19 @@ int main(int argc, char* argv[]) {
 	std::mt19937 rand_gen{ rand_device() };
 	std::uniform_int_distribution<myType> uni_dist(std::numeric_limits<myType>::min(), std::numeric_limits<myType>::max() / elem_num);
 
+	// Not zeroed on construction: the pages are first touched by init_vector on the NUMA node that processes them later.
 	constexpr std::size_t vec_size = 10'000'000;
-	std::vector<myType> vec(vec_size);
+	std::vector<myType, first_touch_allocator<myType>> vec(vec_size);
 
 	const std::size_t thread_count = std::thread::hardware_concurrency();
 
+	// The calling thread takes part in every parallel algorithm too, so the pool needs one worker less than there are hardware threads.
+	// The workers are spread over the NUMA nodes, and every node initializes and then searches its own part of the vector.
+	thread_pool pool(scheduling_mode::shared_queue, wait_strategy::blocking(), thread_placement::numa_nodes);
+	pool.initialize(thread_count > 1 ? thread_count - 1 : 1);
+
 	// Assign random generated values to a vector in multiple threads - fast for giant containers.
-	init_vector(vec, std::min(vec_size, thread_count), rand_gen, uni_dist);
+	init_vector(vec, pool, rand_gen, uni_dist);
 
 	myType sum = 0;
 
@@ -44,25 +50,52 @@ int main(int argc, char* argv[]) {
 	}
 
 	auto atomic_algorithm_start = high_resolution_clock::now();
-	find_n_max_elem_in_vector_atomic(vec, elem_num, thread_count, vec_of_max_atomics);
+	const concurrent_top_k_statistics atomic_statistics = find_n_max_elem_in_vector_atomic(vec, elem_num, pool, vec_of_max_atomics);
 	auto atomic_algorithm_end   = high_resolution_clock::now();
 	auto atomic_algorithm_elapsed = duration_cast<nanoseconds>(atomic_algorithm_end - atomic_algorithm_start);
 
 	std::printf("\n=== Atomic algorithm ===\n");
 	print_result_info(vec, thread_count, vec_of_max_atomics, sum, atomic_algorithm_elapsed);
+	std::printf("CAS failures           : %llu (%llu replacements, %llu late rejections).\n", static_cast<unsigned long long>(atomic_statistics.cas_failures),
+		static_cast<unsigned long long>(atomic_statistics.replacements), static_cast<unsigned long long>(atomic_statistics.late_rejections));
 
 	// Mutex algorithm.
 	std::vector<myType> vec_of_max_values_multithread(elem_num, std::numeric_limits<myType>::min());
 	std::mutex max_values_mutex;
 
 	auto mutex_algorithm_start = high_resolution_clock::now();
-	find_n_max_elem_in_vector_mutex(vec, elem_num, thread_count, vec_of_max_values_multithread, max_values_mutex);
+	find_n_max_elem_in_vector_mutex(vec, elem_num, pool, vec_of_max_values_multithread, max_values_mutex);
 	auto mutex_algorithm_end = high_resolution_clock::now();
 	auto mutex_algorithm_elapsed = duration_cast<nanoseconds>(mutex_algorithm_end - mutex_algorithm_start);
 
 	std::printf("\n=== Mutex algorithm ===\n");
 	print_result_info(vec, thread_count, vec_of_max_values_multithread, sum, mutex_algorithm_elapsed);
 
+	// Reduce algorithm.
+	std::vector<myType> vec_of_max_values_reduce(elem_num, std::numeric_limits<myType>::min());
+
+	auto reduce_algorithm_start = high_resolution_clock::now();
+	find_n_max_elem_in_vector_reduce(vec, elem_num, pool, vec_of_max_values_reduce);
+	auto reduce_algorithm_end = high_resolution_clock::now();
+	auto reduce_algorithm_elapsed = duration_cast<nanoseconds>(reduce_algorithm_end - reduce_algorithm_start);
+
+	std::printf("\n=== Reduce algorithm (%s compares) ===\n", simd_level_name(top_k_simd_level()));
+	print_result_info(vec, thread_count, vec_of_max_values_reduce, sum, reduce_algorithm_elapsed);
+
+	// Reduce algorithm with scalar compares, to compare with the vector kernel used by default.
+	std::vector<myType> vec_of_max_values_reduce_scalar(elem_num, std::numeric_limits<myType>::min());
+	use_top_k_simd_level(simd_level::scalar);
+
+	auto reduce_scalar_algorithm_start = high_resolution_clock::now();
+	find_n_max_elem_in_vector_reduce(vec, elem_num, pool, vec_of_max_values_reduce_scalar);
+	auto reduce_scalar_algorithm_end = high_resolution_clock::now();
+	auto reduce_scalar_algorithm_elapsed = duration_cast<nanoseconds>(reduce_scalar_algorithm_end - reduce_scalar_algorithm_start);
+
+	use_top_k_simd_level(supported_simd_level());
+
+	std::printf("\n=== Reduce algorithm (scalar compares) ===\n");
+	print_result_info(vec, thread_count, vec_of_max_values_reduce_scalar, sum, reduce_scalar_algorithm_elapsed);
+
 	// Singlethreaded algorithm.
 	std::vector<myType> vec_of_max_values_single_thread(elem_num, std::numeric_limits<myType>::min());
 
@@ -74,11 +107,37 @@ int main(int argc, char* argv[]) {
 	std::printf("\n=== Singlethreaded algorithm ===\n");
 	print_result_info(vec, thread_count, vec_of_max_values_single_thread, sum, single_thread_algorithm_elapsed);
 
+	// Reduce algorithm for the top 1% of the vector: selected by radix_select (automatically, see top_k_uses_radix) and by heaps.
+	const std::size_t large_elem_num = vec_size / 100;
+
+	for (const top_k_selection selection : { top_k_selection::automatic, top_k_selection::heap }) {
+		std::vector<myType> vec_of_large_max_values(large_elem_num, std::numeric_limits<myType>::min());
+		use_top_k_selection(selection);
+
+		auto large_algorithm_start = high_resolution_clock::now();
+		find_n_max_elem_in_vector_reduce(vec, large_elem_num, pool, vec_of_large_max_values);
+		auto large_algorithm_end = high_resolution_clock::now();
+		auto large_algorithm_elapsed = duration_cast<nanoseconds>(large_algorithm_end - large_algorithm_start);
+
+		long long large_sum = 0;
+		for (const myType max_value : vec_of_large_max_values) {
+			large_sum += max_value;
+		}
+
+		std::printf("\n=== Reduce algorithm, top 1%% (%s selection, %s) ===\n", top_k_selection_name(selection), top_k_uses_radix(vec.size(), large_elem_num) ? "radix" : "heap");
+		std::printf("Amount of max elements : %llu.\n", static_cast<unsigned long long>(large_elem_num));
+		std::printf("Max / min selected     : %d / %d.\n", vec_of_large_max_values.front(), vec_of_large_max_values.back());
+		std::printf("The sum is             : %lld.\n", large_sum);
+		std::printf("Execution time         : %.4f seconds.\n", large_algorithm_elapsed.count() * 1e-9);
+	}
+
+	use_top_k_selection(top_k_selection::automatic);
+
 	return 0;
 }
 
-template <typename T, typename U>
-inline void print_result_info(const std::vector<T>& vec, const std::size_t thread_count_info, const std::vector<U>& max_values, T& sum, const nanoseconds& elapsed_ns) {
+template <typename T, typename allocator_t, typename U>
+inline void print_result_info(const std::vector<T, allocator_t>& vec, const std::size_t thread_count_info, const std::vector<U>& max_values, T& sum, const nanoseconds& elapsed_ns) {
 	std::printf("Vector size            : %llu.\n", vec.size());
 	std::printf("Amount of threads      : %llu.\n", thread_count_info);
 	std::printf("Amount of max elements : %llu.\n", max_values.size());
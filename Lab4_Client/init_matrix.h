@@ -1,8 +1,12 @@
 #pragma once
 
-#include <thread>
 #include <vector>
 #include <random>
+#include <algorithm>
+#include <bit>
+
+#include "parallel_algorithms.h"
+#include "task_graph.h"
 
 // Assign random generated values into the given range. Part of the matrix initialization initMatrixVector function.
 template <typename T>
@@ -12,31 +16,57 @@ inline void initVecRange(const typename std::vector<T>::iterator itBegin, const
 		});
 }
 
-// Initialize given matrix with random values.
+// Initialize given matrix with random values on the workers of the given thread pool. Every task initializes a block of whole rows
+// with its own generator seeded from rand_gen, so the workers never share the generator state.
+// With a NUMA-placed pool every node initializes the same block of rows on every call (see thread_pool::placement_groups).
 template <typename T>
-inline void initMatrixVector(std::vector<T>& matrix, const std::size_t dimension, std::size_t thread_count, std::mt19937& rand_gen, std::uniform_int_distribution<T>& uni_dist) {
-	if (dimension < thread_count) {
-		thread_count = dimension;
-	}
-	
-	const std::size_t rowStep = dimension / thread_count;
-	const std::size_t remainder = (dimension - rowStep * thread_count == 0 ? 0 : dimension - rowStep * (thread_count - 1));
+inline void initMatrixVector(std::vector<T>& matrix, const std::size_t dimension, thread_pool& pool, std::mt19937& rand_gen, std::uniform_int_distribution<T>& uni_dist) {
+	const std::mt19937::result_type seed = rand_gen();
 
-	std::vector<std::thread> initVecThreads(thread_count);
+	parallel_for(pool, std::size_t(0), dimension, 1, [&matrix, dimension, seed, &uni_dist](const std::size_t firstRow, const std::size_t lastRow) {
+		std::seed_seq chunkSeed{ seed, static_cast<std::mt19937::result_type>(firstRow) };
+		std::mt19937 chunkRandGen(chunkSeed);
+		std::uniform_int_distribution<T> chunkUniDist(uni_dist.param());
 
-	if (remainder == 0) {
-		for (std::size_t i = 0; i < thread_count; ++i) {
-			initVecThreads[i] = std::thread(initVecRange<T>, matrix.begin() + i * dimension * rowStep, matrix.begin() + (i + 1) * dimension * rowStep, std::ref(rand_gen), std::ref(uni_dist));
-		}
-	}
-	else {
-		for (std::size_t i = 0; i < thread_count - 1; ++i) {
-			initVecThreads[i] = std::thread(initVecRange<T>, matrix.begin() + i * dimension * rowStep, matrix.begin() + (i + 1) * dimension * rowStep, std::ref(rand_gen), std::ref(uni_dist));
-		}
-		initVecThreads[thread_count - 1] = std::thread(initVecRange<T>, matrix.end() - dimension * remainder, matrix.end(), std::ref(rand_gen), std::ref(uni_dist));
-	}
+		initVecRange<T>(matrix.begin() + firstRow * dimension, matrix.begin() + lastRow * dimension, chunkRandGen, chunkUniDist);
+	});
+}
+
+// Same as initMatrixVector, but also converts the matrix to big-endian for sending (if toBigEndian and the host is little-endian).
+// Both phases are one task graph with an edge per block of rows, so a block is converted as soon as it is initialized
+// instead of after the whole matrix.
+template <typename T>
+inline void initMatrixVectorForSending(std::vector<T>& matrix, const std::size_t dimension, thread_pool& pool, std::mt19937& rand_gen, std::uniform_int_distribution<T>& uni_dist, const bool toBigEndian) {
+	const std::mt19937::result_type seed = rand_gen();
+
+	const std::size_t blockRows = parallel_chunk_size(dimension, 1, pool.worker_count() + 1);
+	const std::size_t blocksAmount = (dimension + blockRows - 1) / blockRows;
 
-	for (auto& initVecThread : initVecThreads) {
-		initVecThread.join();
+	auto firstRowOf = [dimension, blockRows](const std::size_t block) {
+		return (block * blockRows < dimension ? block * blockRows : dimension);
+	};
+
+	task_graph graph;
+
+	const task_graph::node_range initializedBlocks = graph.add_nodes(blocksAmount, [&](const std::size_t block) {
+		const std::size_t firstRow = firstRowOf(block);
+
+		std::seed_seq chunkSeed{ seed, static_cast<std::mt19937::result_type>(firstRow) };
+		std::mt19937 chunkRandGen(chunkSeed);
+		std::uniform_int_distribution<T> chunkUniDist(uni_dist.param());
+
+		initVecRange<T>(matrix.begin() + firstRow * dimension, matrix.begin() + firstRowOf(block + 1) * dimension, chunkRandGen, chunkUniDist);
+	});
+
+	if (toBigEndian && std::endian::native != std::endian::big) {
+		const task_graph::node_range convertedBlocks = graph.add_nodes(blocksAmount, [&](const std::size_t block) {
+			std::transform(matrix.begin() + firstRowOf(block) * dimension, matrix.begin() + firstRowOf(block + 1) * dimension, matrix.begin() + firstRowOf(block) * dimension, [](T elem) {
+				return std::byteswap(elem);
+			});
+		});
+
+		graph.add_chunk_edges(initializedBlocks, convertedBlocks);
 	}
+
+	graph.run(pool);
 }
\ No newline at end of file
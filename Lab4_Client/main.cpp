@@ -23,7 +23,10 @@ int main(int argc, char* argv[]) {
 
 	// Assign random generated values to a vector in multiple threads - fast for giant containers.
 	const std::size_t hardware_concurrency = std::thread::hardware_concurrency();
-	initMatrixVector(matrix, dimension, (dimension < hardware_concurrency ? dimension : hardware_concurrency), randGen, uniDist);
+	thread_pool pool(scheduling_mode::shared_queue, wait_strategy::blocking(), thread_placement::numa_nodes);
+	pool.initialize(hardware_concurrency > 1 ? hardware_concurrency - 1 : 1);
+	// The matrix is converted to big-endian right away, block by block as the blocks get initialized, so send_data doesn't have to.
+	initMatrixVectorForSending(matrix, dimension, pool, randGen, uniDist, true);
 
 	tcp_client::init_protocol();
 
@@ -38,9 +41,9 @@ int main(int argc, char* argv[]) {
 		std::uint32_t array_size_in_bytes = matrix.size() * sizeof(myType);
 		std::uint16_t thread_count = 16;
 
-		// Last argument true - for the first time, we need to cast array data to big endian (no affect if host is already big-endian).
+		// Last argument false - the array data is already big-endian (converted by initMatrixVectorForSending).
 		std::cout << "CLIENT: sending data...\n";
-		int response_code = client.send_data(array_size_in_bytes, dimension, thread_count, matrix, true);
+		int response_code = client.send_data(array_size_in_bytes, dimension, thread_count, matrix, false);
 		std::cout << "SERVER RESPONSE: " << client.get_response_from_code(response_code) << ".\n";
 
 		while (response_code) {
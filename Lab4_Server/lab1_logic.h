@@ -2,26 +2,41 @@
 
 #include <vector>
 #include <atomic>
+#include <span>
+#include <functional>
+
+#include "top_k.h"
 
 // Find minimal element in the given range and assign it to vec[index]. Part of the algorithm.
+// The bottom-1 selection of the shared engine (select_first, which allocates nothing), so an int32_t row is scanned with vector compares.
 template <typename T>
 inline void replace_with_min(std::vector<T>& vec, const typename std::vector<T>::iterator it_begin, const typename std::vector<T>::iterator it_end, const std::size_t index) {
-	typename std::vector<T>::iterator it = std::min_element(it_begin, it_end);
-	if (it != it_end) {
-		vec[index] = *it;
+	const T* const min_value = select_first(std::span<const T>(it_begin, it_end), std::less<>());
+	if (min_value != nullptr) {
+		vec[index] = *min_value;
 	}
 }
 
 enum class status { not_processed, in_progress, processed };
 
-// Algorithm function called in threads.
+// The algorithm for the given rows only. Every row is only read and written by itself, so blocks of rows can be processed independently.
 template <typename T>
-inline void parse_matrix_rows(std::vector<T>& vec, const typename std::vector<T>::iterator it_begin, const std::size_t dimension, const std::size_t rows, const std::size_t init_index, std::atomic<int>& progress_threads_done, const std::size_t thread_count, std::atomic<status>& current_status) {
+inline void process_matrix_rows(std::vector<T>& vec, const typename std::vector<T>::iterator it_begin, const std::size_t dimension, const std::size_t rows, const std::size_t init_index) {
 	for (std::size_t i = 0; i < rows; ++i) {
 		replace_with_min(vec, it_begin + i * dimension, it_begin + (i + 1) * dimension, init_index + i * dimension - i);
 	}
-	
+}
+
+// Counts one more finished part of the work; the last one marks the whole matrix as processed.
+inline void report_progress(std::atomic<int>& progress_threads_done, const std::size_t thread_count, std::atomic<status>& current_status) {
 	if (++progress_threads_done == thread_count) {
 		current_status = status::processed;
 	}
+}
+
+// Algorithm function called in threads.
+template <typename T>
+inline void parse_matrix_rows(std::vector<T>& vec, const typename std::vector<T>::iterator it_begin, const std::size_t dimension, const std::size_t rows, const std::size_t init_index, std::atomic<int>& progress_threads_done, const std::size_t thread_count, std::atomic<status>& current_status) {
+	process_matrix_rows(vec, it_begin, dimension, rows, init_index);
+	report_progress(progress_threads_done, thread_count, current_status);
 }
\ No newline at end of file
@@ -1,10 +1,19 @@
 #include "tcp_server.h"
+#include "trace_recorder.h"
 
 #include <iostream>
+#include <string>
 
 //#pragma comment(linker, "/HEAP:3000000")
 
 int main(int argc, char* argv[]) {
+	for (int i = 1; i + 1 < argc; ++i) {
+		// --trace <file>: records the commands of the clients and their processing; every Enter on the console writes them to file as Chrome trace JSON.
+		if (std::string(argv[i]) == "--trace") {
+			trace_recorder::get().write_on_enter(argv[i + 1]);
+		}
+	}
+
 	tcp_server::init_protocol();
 
 	tcp_server server;
@@ -20,6 +29,7 @@ int main(int argc, char* argv[]) {
 		SOCKET client_socket;
 		
 		while(client_socket = accept(server.get_socket(), (sockaddr*)&client_addr, &client_addr_size)) {
+			trace_recorder::get().record("accept", "tcp_server", trace_phase::instant, client_socket);
 			std::thread client_thread(&tcp_server::serve_client, &server, client_socket);
 			client_thread.detach();
 		}
@@ -14,6 +14,9 @@
 #include <mutex>
 
 #include "lab1_logic.h"
+#include "task_graph.h"
+#include "task_group.h"
+#include "trace_recorder.h"
 
 #pragma comment(lib, "ws2_32.lib")
 
@@ -34,9 +37,9 @@ public:
 	inline SOCKET get_socket() const;
 
 private:
-	inline void recv_array_data(SOCKET& client_socket, std::vector<std::int32_t>& client_matrix, std::uint32_t array_size_in_bytes, std::atomic<status>& current_status) const;
+	inline void recv_array_data(SOCKET& client_socket, std::vector<std::int32_t>& client_matrix, std::uint32_t array_size_in_bytes, std::atomic<status>& current_status, task_group& processing) const;
 
-	inline void start_processing(std::vector<std::int32_t>& client_matrix, std::int16_t dimension, std::int16_t thread_count, std::atomic<int>& progress_threads_done, std::atomic<status>& current_status) const;
+	inline void start_processing(std::vector<std::int32_t>& client_matrix, std::int16_t dimension, std::int16_t thread_count, std::atomic<int>& progress_threads_done, std::atomic<status>& current_status, task_group& processing) const;
 
 	inline void get_result(SOCKET& client_socket, std::vector<std::int32_t>& client_matrix, std::uint32_t last_processing_array_size_in_bytes, std::int16_t last_processing_thread_count, std::atomic<int>& progress_threads_done, std::atomic<status>& current_status) const;
 
@@ -51,6 +54,9 @@ protected:
 private:
 	SOCKET m_socket;
 
+	// Persistent workers shared by the processing of all clients (start_processing is called from const serve_client).
+	mutable thread_pool m_processing_pool;
+
 	constexpr static bool is_big_endian = std::endian::native == std::endian::big;
 };
 
@@ -76,6 +82,9 @@ inline tcp_server::tcp_server() {
 		std::string error_message = "Error creating socket: " + get_last_error_as_string() + ".";
 		throw std::exception(error_message.c_str());
 	}
+
+	const std::size_t hardware_concurrency = std::thread::hardware_concurrency();
+	m_processing_pool.initialize(hardware_concurrency > 0 ? hardware_concurrency : 1);
 }
 
 inline tcp_server::~tcp_server() {
@@ -113,11 +122,24 @@ inline void tcp_server::serve_client(SOCKET client_socket) const {
 
 	bool need_to_close_connection = false;
 
+	// The processing of this client's matrix. Declared after everything its tasks refer to, so it is destroyed (and waited for) first.
+	task_group processing(m_processing_pool);
+
+	// Phases of the commands, recorded while trace_recorder is started (see main.cpp, --trace).
 	while (!need_to_close_connection) {
 		char response_code = 0;
 		char recv_buffer[9];
 		
+		trace_scope recv_trace("recv command", "tcp_server", client_socket);
 		int recv_size = recv(client_socket, recv_buffer, sizeof(recv_buffer), 0);
+		recv_trace.finish();
+
+		if (recv_size == 0 || (recv_size == SOCKET_ERROR && WSAGetLastError() == WSAECONNRESET)) {
+			// The client has disconnected - nobody will ask for the result.
+			closesocket(client_socket);
+			break;
+		}
+
 		if (recv_size == SOCKET_ERROR) {
 			// Send error code to client.
 			response_code = 2;
@@ -136,10 +158,12 @@ inline void tcp_server::serve_client(SOCKET client_socket) const {
 			thread_count = *reinterpret_cast<std::uint16_t*>(&recv_buffer[7]);
 			thread_count = ntohs(thread_count);
 
-			recv_array_data(client_socket, client_matrix, array_size_in_bytes, current_status);
+			recv_array_data(client_socket, client_matrix, array_size_in_bytes, current_status, processing);
 		}
 		// Start processing.
 		else if (recv_buffer[0] == static_cast<char>(254)) {
+			const trace_scope start_trace("start processing", "tcp_server", client_socket);
+
 			if (client_matrix.size() == 0) {
 				// Send error code to client.
 				response_code = 5;
@@ -157,7 +181,7 @@ inline void tcp_server::serve_client(SOCKET client_socket) const {
 
 			last_processing_thread_count = (dimension < thread_count) ? dimension : thread_count;
 			last_processing_array_size_in_bytes = array_size_in_bytes;
-			start_processing(client_matrix, dimension, last_processing_thread_count, progress_threads_done, current_status);
+			start_processing(client_matrix, dimension, last_processing_thread_count, progress_threads_done, current_status, processing);
 			
 			response_code = 0;
 			send(client_socket, &response_code, 1, 0);
@@ -170,13 +194,18 @@ inline void tcp_server::serve_client(SOCKET client_socket) const {
 			close_connection(client_socket, need_to_close_connection);
 		}
 	}
+
+	// Stops the abandoned processing instead of letting it run to the end; the destructor of processing waits for the running blocks.
+	processing.cancel();
 }
 
 inline SOCKET tcp_server::get_socket() const {
 	return m_socket;
 }
 
-inline void tcp_server::recv_array_data(SOCKET& client_socket, std::vector<std::int32_t>& client_matrix, std::uint32_t array_size_in_bytes, std::atomic<status>& current_status) const {
+inline void tcp_server::recv_array_data(SOCKET& client_socket, std::vector<std::int32_t>& client_matrix, std::uint32_t array_size_in_bytes, std::atomic<status>& current_status, task_group& processing) const {
+	const trace_scope recv_trace("recv array", "tcp_server", client_socket);
+
 	char response_code = 0;
 	std::uint32_t total_received = 0;
 	
@@ -197,12 +226,10 @@ inline void tcp_server::recv_array_data(SOCKET& client_socket, std::vector<std::
 	}
 
 	if (current_status == status::in_progress) {
-		// Send error code to client.
-		response_code = 4;
-		send(client_socket, &response_code, 1, 0);
-
-		delete[] data_recv_buffer;
-		return;
+		// New data replaces the matrix being processed: its processing is abandoned (the remaining blocks are dropped
+		// and the running ones stop at the next row) instead of finishing on a matrix nobody will ask for.
+		processing.cancel();
+		processing.wait();
 	}
 
 	current_status = status::not_processed;
@@ -223,36 +250,57 @@ inline void tcp_server::recv_array_data(SOCKET& client_socket, std::vector<std::
 	send(client_socket, &response_code, 1, 0);
 }
 
-inline void tcp_server::start_processing(std::vector<std::int32_t>& client_matrix, std::int16_t dimension, std::int16_t thread_count, std::atomic<int>& progress_threads_done, std::atomic<status>& current_status) const {
+inline void tcp_server::start_processing(std::vector<std::int32_t>& client_matrix, std::int16_t dimension, std::int16_t thread_count, std::atomic<int>& progress_threads_done, std::atomic<status>& current_status, task_group& processing) const {
 	progress_threads_done = 0;
 	
 	if (dimension < thread_count) {
 		thread_count = dimension;
 	}
 
-	const std::size_t row_step = dimension / thread_count;
-	const std::size_t remainder = (dimension - row_step * thread_count == 0 ? 0 : dimension - row_step * (thread_count - 1));
+	// The matrix is split into thread_count blocks of rows, like before, but the blocks are processed by the persistent pool
+	// (the task itself runs the graph, so start_processing returns immediately). A block is converted to big-endian for get_result
+	// as soon as it is processed, without waiting for the other blocks. Every converted block counts as one done "thread"
+	// for the progress reported by get_result, so the matrix is only marked processed once it is ready to be sent.
+	// The processing belongs to the client's task group: when the group is cancelled, blocks that haven't started are skipped
+	// and the running ones stop after their current row.
+	processing.run([this, &client_matrix, dimension, thread_count, &progress_threads_done, &current_status, cancellation = processing.token()] {
+		const trace_scope process_trace("process", "tcp_server", client_matrix.size());
 
-	std::vector<std::thread> threads(thread_count);
+		const std::size_t blocks_amount = thread_count;
 
-	if (remainder == 0) {
-		for (std::size_t i = 0; i < thread_count; ++i) {
-			threads[i] = std::thread(parse_matrix_rows<std::int32_t>, std::ref(client_matrix), client_matrix.begin() + i * row_step * dimension, dimension, row_step, dimension + i * row_step * dimension - 1 - i * row_step, std::ref(progress_threads_done), thread_count, std::ref(current_status));
-		}
-	}
-	else {
-		for (std::size_t i = 0; i < thread_count - 1; ++i) {
-			threads[i] = std::thread(parse_matrix_rows<std::int32_t>, std::ref(client_matrix), client_matrix.begin() + i * row_step * dimension, dimension, row_step, dimension + i * row_step * dimension - 1 - i * row_step, std::ref(progress_threads_done), thread_count, std::ref(current_status));
-		}
-		threads[thread_count - 1] = std::thread(parse_matrix_rows<std::int32_t>, std::ref(client_matrix), client_matrix.end() - dimension * remainder, dimension, remainder, client_matrix.size() - remainder * dimension + remainder - 1, std::ref(progress_threads_done), thread_count, std::ref(current_status));
-	}
+		auto first_row_of = [dimension, blocks_amount](const std::size_t block) {
+			return block * dimension / blocks_amount;
+		};
 
-	for (auto& thread : threads) {
-		thread.detach();
-	}
+		task_graph blocks_processing;
+
+		const task_graph::node_range processed_blocks = blocks_processing.add_nodes(blocks_amount, [&](const std::size_t block) {
+			const trace_scope block_trace("process block", "tcp_server", block);
+			const std::size_t last_row = first_row_of(block + 1);
+
+			for (std::size_t row = first_row_of(block); row < last_row && !cancellation.is_cancelled(); ++row) {
+				process_matrix_rows<std::int32_t>(client_matrix, client_matrix.begin() + row * dimension, dimension, 1, (row + 1) * (dimension - 1));
+			}
+		});
+
+		const task_graph::node_range converted_blocks = blocks_processing.add_nodes(blocks_amount, [&](const std::size_t block) {
+			if (!is_big_endian) {
+				std::transform(client_matrix.begin() + first_row_of(block) * dimension, client_matrix.begin() + first_row_of(block + 1) * dimension, client_matrix.begin() + first_row_of(block) * dimension, [](std::int32_t elem) {
+					return std::byteswap(elem);
+				});
+			}
+
+			report_progress(progress_threads_done, blocks_amount, current_status);
+		});
+
+		blocks_processing.add_chunk_edges(processed_blocks, converted_blocks);
+		blocks_processing.run(m_processing_pool, cancellation);
+	});
 }
 
 inline void tcp_server::get_result(SOCKET& client_socket, std::vector<std::int32_t>& client_matrix, std::uint32_t last_processing_array_size_in_bytes, std::int16_t last_processing_thread_count, std::atomic<int>& progress_threads_done, std::atomic<status>& current_status) const {
+	const trace_scope send_trace("send result", "tcp_server", client_socket);
+
 	char response_code_and_progress[2];
 	response_code_and_progress[0] = 0;
 
@@ -271,12 +319,7 @@ inline void tcp_server::get_result(SOCKET& client_socket, std::vector<std::int32
 	send(client_socket, response_code_and_progress, 2, 0);
 
 	if (stutus_at_moment == status::processed) {
-		if (!is_big_endian) {
-			std::transform(client_matrix.begin(), client_matrix.end(), client_matrix.begin(), [](std::int32_t elem) {
-				return std::byteswap(elem);
-			});
-		}
-
+		// Already converted to big-endian by start_processing.
 		const char* const data = reinterpret_cast<const char*>(client_matrix.data());
 		const int chunk_size = 1024;
 		int total_sent = 0;
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "concurrent_queue.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#endif
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) && std::atomic<std::uint32_t>::is_always_lock_free,
+	"atomic_wait_until waits on the address of the atomic word itself.");
+
+// Futex-style waiting with a deadline, which std::atomic::wait doesn't have: blocks while word == expected, until woken by
+// atomic_notify_all or until deadline (time_point::max() waits without a limit). May return spuriously, so callers re-check their
+// condition. Returns false once the deadline has passed. Words waited on this way must be woken with atomic_notify_all, not notify_all.
+inline bool atomic_wait_until(const std::atomic<std::uint32_t>& word, const std::uint32_t expected, const std::chrono::steady_clock::time_point deadline);
+inline void atomic_notify_all(std::atomic<std::uint32_t>& word);
+
+// Amount of unfinished work (queued and running tasks) that threads can wait to drop to zero.
+// Waiters register themselves, so finishing the last piece of work costs a wake-up call only when somebody is actually waiting;
+// nobody polls, so a waiter returns as soon as the last task is done.
+class completion_counter {
+public:
+	inline void add(const std::size_t amount = 1) { m_pending.fetch_add(amount, std::memory_order_relaxed); }
+	inline void finish(const std::size_t amount = 1);
+
+	// Forgets all pending work (e.g. tasks deleted without running) and wakes the waiters.
+	inline void reset();
+
+	inline bool is_idle() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+	// Returns false if the work was still pending at deadline.
+	inline bool wait_until(const std::chrono::steady_clock::time_point deadline) const;
+	inline void wait() const { wait_until(std::chrono::steady_clock::time_point::max()); }
+
+private:
+	inline void signal_idle();
+
+	alignas(cache_line_size) std::atomic<std::size_t>	m_pending		= 0;
+	std::atomic<std::uint32_t>							m_idle_epoch	= 0;	// Incremented whenever m_pending drops to zero.
+	mutable std::atomic<std::uint32_t>					m_waiters		= 0;
+};
+
+
+#ifdef _WIN32
+
+inline bool atomic_wait_until(const std::atomic<std::uint32_t>& word, std::uint32_t expected, const std::chrono::steady_clock::time_point deadline) {
+	DWORD milliseconds = INFINITE;
+
+	if (deadline != std::chrono::steady_clock::time_point::max()) {
+		const auto now = std::chrono::steady_clock::now();
+		if (now >= deadline) {
+			return false;
+		}
+
+		// Rounded up, so the wait doesn't end just before the deadline and spin on zero-length waits.
+		const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+		milliseconds = (remaining < INFINITE - 1 ? static_cast<DWORD>(remaining) : INFINITE - 1);
+	}
+
+	WaitOnAddress(const_cast<std::atomic<std::uint32_t>*>(&word), &expected, sizeof(expected), milliseconds);
+	return std::chrono::steady_clock::now() < deadline;
+}
+
+inline void atomic_notify_all(std::atomic<std::uint32_t>& word) {
+	WakeByAddressAll(&word);
+}
+
+#elif defined(__linux__)
+
+inline bool atomic_wait_until(const std::atomic<std::uint32_t>& word, const std::uint32_t expected, const std::chrono::steady_clock::time_point deadline) {
+	timespec timeout = {};
+	timespec* timeout_pointer = nullptr;
+
+	if (deadline != std::chrono::steady_clock::time_point::max()) {
+		const auto now = std::chrono::steady_clock::now();
+		if (now >= deadline) {
+			return false;
+		}
+
+		const auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+		timeout.tv_sec = static_cast<time_t>(remaining / 1000000000);
+		timeout.tv_nsec = static_cast<long>(remaining % 1000000000);
+		timeout_pointer = &timeout;
+	}
+
+	syscall(SYS_futex, &word, FUTEX_WAIT_PRIVATE, expected, timeout_pointer, nullptr, 0);
+	return std::chrono::steady_clock::now() < deadline;
+}
+
+inline void atomic_notify_all(std::atomic<std::uint32_t>& word) {
+	syscall(SYS_futex, &word, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+// No futex available: short sleeps bound the delay instead.
+inline bool atomic_wait_until(const std::atomic<std::uint32_t>& word, const std::uint32_t expected, const std::chrono::steady_clock::time_point deadline) {
+	if (word.load(std::memory_order_acquire) == expected) {
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+
+	return std::chrono::steady_clock::now() < deadline;
+}
+
+inline void atomic_notify_all(std::atomic<std::uint32_t>&) {}
+
+#endif
+
+inline void completion_counter::finish(const std::size_t amount) {
+	if (m_pending.fetch_sub(amount, std::memory_order_seq_cst) == amount) {
+		signal_idle();
+	}
+}
+
+inline void completion_counter::reset() {
+	if (m_pending.exchange(0, std::memory_order_seq_cst) != 0) {
+		signal_idle();
+	}
+}
+
+inline void completion_counter::signal_idle() {
+	// Seq_cst against the waiter's m_waiters increment and m_pending check: either the waiter sees m_pending == 0,
+	// or this sees the waiter and wakes it (its futex compares the epoch, which has already changed).
+	m_idle_epoch.fetch_add(1, std::memory_order_seq_cst);
+
+	if (m_waiters.load(std::memory_order_seq_cst) > 0) {
+		atomic_notify_all(m_idle_epoch);
+	}
+}
+
+inline bool completion_counter::wait_until(const std::chrono::steady_clock::time_point deadline) const {
+	if (is_idle()) {
+		return true;
+	}
+
+	m_waiters.fetch_add(1, std::memory_order_seq_cst);
+
+	bool idle = false;
+	while (true) {
+		const std::uint32_t seen_epoch = m_idle_epoch.load(std::memory_order_seq_cst);
+
+		if (m_pending.load(std::memory_order_seq_cst) == 0) {
+			idle = true;
+			break;
+		}
+
+		if (!atomic_wait_until(m_idle_epoch, seen_epoch, deadline)) {
+			idle = is_idle();
+			break;
+		}
+	}
+
+	m_waiters.fetch_sub(1, std::memory_order_relaxed);
+	return idle;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+// Thrown by cancellation_token::throw_if_cancelled. task_group treats it as the normal end of a cancelled task, not as a failure.
+class operation_cancelled : public std::runtime_error {
+public:
+	inline operation_cancelled() : std::runtime_error("The operation was cancelled.") {}
+};
+
+// Read side of a cancellation flag, handed to running tasks so they can stop early. Checking it is a single relaxed load, cheap
+// enough for every iteration of a loop. A default-constructed token is never cancelled.
+class cancellation_token {
+public:
+	inline cancellation_token() noexcept = default;
+
+	inline bool is_cancelled() const noexcept { return m_flag != nullptr && m_flag->load(std::memory_order_relaxed); }
+	inline void throw_if_cancelled() const;
+
+private:
+	friend class cancellation_source;
+
+	inline explicit cancellation_token(std::shared_ptr<const std::atomic<bool>> flag) noexcept : m_flag(std::move(flag)) {}
+
+	std::shared_ptr<const std::atomic<bool>> m_flag;
+};
+
+// Owner of a cancellation flag: cancel() is seen by every token taken from it.
+class cancellation_source {
+public:
+	inline cancellation_source() : m_flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+public:
+	inline cancellation_token token() const noexcept { return cancellation_token(m_flag); }
+
+	inline void cancel() noexcept { m_flag->store(true, std::memory_order_relaxed); }
+	inline bool is_cancelled() const noexcept { return m_flag->load(std::memory_order_relaxed); }
+
+	// Clears the flag, so the tokens are valid again. Only for when nothing that was cancelled through them is still running.
+	inline void reset() noexcept { m_flag->store(false, std::memory_order_relaxed); }
+
+private:
+	std::shared_ptr<std::atomic<bool>> m_flag;
+};
+
+
+inline void cancellation_token::throw_if_cancelled() const {
+	if (is_cancelled()) {
+		throw operation_cancelled();
+	}
+}
\ No newline at end of file
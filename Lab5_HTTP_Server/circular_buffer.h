@@ -0,0 +1,124 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+// Growable ring buffer with the sequence container interface needed by std::queue and work_stealing_queue.
+// Unlike std::deque (which MSVC allocates block by block, one block per element for anything larger than 8 bytes),
+// it reuses one power-of-two sized array and only allocates when it has to grow, so a warmed-up queue never touches the heap.
+template <typename type>
+class circular_buffer {
+public:
+	using value_type		= type;
+	using size_type			= std::size_t;
+	using reference			= type&;
+	using const_reference	= const type&;
+
+public:
+	inline circular_buffer() = default;
+	inline ~circular_buffer();
+
+public:
+	inline bool empty() const { return m_size == 0; }
+	inline size_type size() const { return m_size; }
+
+	inline reference front()				{ return m_elements[m_head]; }
+	inline const_reference front() const	{ return m_elements[m_head]; }
+	inline reference back()					{ return m_elements[(m_head + m_size - 1) & (m_capacity - 1)]; }
+	inline const_reference back() const		{ return m_elements[(m_head + m_size - 1) & (m_capacity - 1)]; }
+
+	template <typename... arguments>
+	inline reference emplace_back(arguments&&... parameters);
+	inline void push_back(const type& value) { emplace_back(value); }
+	inline void push_back(type&& value) { emplace_back(std::move(value)); }
+
+	inline void pop_front();
+	inline void pop_back();
+
+	// Destroys all elements but keeps the allocated array for reuse.
+	inline void clear();
+
+public:
+	inline circular_buffer(const circular_buffer& other) = delete;
+	inline circular_buffer(circular_buffer&& other) = delete;
+	inline circular_buffer& operator=(const circular_buffer& rhs) = delete;
+	inline circular_buffer& operator=(circular_buffer&& rhs) = delete;
+
+private:
+	inline void grow();
+
+	static constexpr size_type m_initial_capacity = 16;
+
+	std::allocator<type>	m_allocator;
+	type*					m_elements	= nullptr;
+	size_type				m_capacity	= 0;
+	size_type				m_head		= 0;
+	size_type				m_size		= 0;
+};
+
+
+template <typename type>
+circular_buffer<type>::~circular_buffer() {
+	clear();
+
+	if (m_elements != nullptr) {
+		m_allocator.deallocate(m_elements, m_capacity);
+	}
+}
+
+template <typename type>
+template <typename... arguments>
+typename circular_buffer<type>::reference circular_buffer<type>::emplace_back(arguments&&... parameters) {
+	if (m_size == m_capacity) {
+		grow();
+	}
+
+	type* const element = m_elements + ((m_head + m_size) & (m_capacity - 1));
+	::new (static_cast<void*>(element)) type(std::forward<arguments>(parameters)...);
+	++m_size;
+
+	return *element;
+}
+
+template <typename type>
+void circular_buffer<type>::pop_front() {
+	std::destroy_at(m_elements + m_head);
+	m_head = (m_head + 1) & (m_capacity - 1);
+	--m_size;
+}
+
+template <typename type>
+void circular_buffer<type>::pop_back() {
+	std::destroy_at(&back());
+	--m_size;
+}
+
+template <typename type>
+void circular_buffer<type>::clear() {
+	while (!empty()) {
+		pop_front();
+	}
+
+	m_head = 0;
+}
+
+template <typename type>
+void circular_buffer<type>::grow() {
+	const size_type new_capacity = (m_capacity == 0 ? m_initial_capacity : m_capacity * 2);
+	type* const new_elements = m_allocator.allocate(new_capacity);
+
+	// Unwrap the elements into the beginning of the new array.
+	for (size_type i = 0; i < m_size; ++i) {
+		type* const element = m_elements + ((m_head + i) & (m_capacity - 1));
+		::new (static_cast<void*>(new_elements + i)) type(std::move_if_noexcept(*element));
+		std::destroy_at(element);
+	}
+
+	if (m_elements != nullptr) {
+		m_allocator.deallocate(m_elements, m_capacity);
+	}
+
+	m_elements	= new_elements;
+	m_capacity	= new_capacity;
+	m_head		= 0;
+}
\ No newline at end of file
@@ -2,15 +2,56 @@
 
 #include <queue>
 #include <thread>
+#include <mutex>
 #include <shared_mutex>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "circular_buffer.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 using read_write_lock = std::shared_mutex;
 using read_lock = std::shared_lock<read_write_lock>;
 using write_lock = std::unique_lock<read_write_lock>;
 
-template <typename type>
-class concurrent_queue {
-	using concurrent_queue_implementation = std::queue<type>;
+// Alignment used to keep independently updated data (per-worker queues, counters) on separate cache lines.
+constexpr std::size_t cache_line_size = 64;
+
+// Hint to the CPU that the current thread is busy-waiting (pause instruction on x86).
+inline void cpu_relax() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	_mm_pause();
+#else
+	std::this_thread::yield();
+#endif
+}
+
+// locked      - unbounded std::queue (over a circular_buffer, so it doesn't allocate per element) protected by a mutex.
+// ring_buffer - lock-free bounded multi-producer multi-consumer ring buffer of ring_capacity elements.
+enum class queue_backend { locked, ring_buffer };
+
+// What emplace does when the ring buffer is full (the locked backend is never full):
+// block  - sleep until a consumer frees a slot;
+// reject - return false immediately, the element is not added;
+// spin   - busy-wait with a pause instruction until a slot is free.
+enum class full_queue_policy { block, reject, spin };
+
+// ring_capacity and policy are only used by the ring_buffer backend. ring_capacity must be a power of two.
+template <typename type, queue_backend backend = queue_backend::locked, std::size_t ring_capacity = 1024, full_queue_policy policy = full_queue_policy::block>
+class concurrent_queue;
+
+// ===== Locked backend =====
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+class concurrent_queue<type, queue_backend::locked, ring_capacity, policy> {
+	using concurrent_queue_implementation = std::queue<type, circular_buffer<type>>;
 
 public:
 	inline concurrent_queue() = default;
@@ -24,8 +65,13 @@ public:
 	inline bool pop(type& value);
 	inline bool pop();
 
+	// Always succeeds and returns true - the queue is unbounded.
 	template <typename... arguments>
-	inline void emplace(arguments&&... parameters);
+	inline bool emplace(arguments&&... parameters);
+
+	// Adds amount elements returned by successive make_element() calls under one lock. Returns amount.
+	template <typename factory_t>
+	inline std::size_t emplace_batch(const std::size_t amount, factory_t& make_element);
 
 public:
 	inline concurrent_queue(const concurrent_queue& other) = delete;
@@ -34,35 +80,36 @@ public:
 	inline concurrent_queue& operator=(concurrent_queue&& rhs) = delete;
 
 private:
-	mutable read_write_lock m_rw_lock;
+	// Every modifying operation needs exclusive access, so a plain mutex is cheaper than a reader/writer lock here.
+	mutable std::mutex m_mutex;
 	concurrent_queue_implementation m_queue;
 };
 
 
-template <typename type>
-bool concurrent_queue<type>::empty() const {
-	read_lock r_lock(m_rw_lock);
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+bool concurrent_queue<type, queue_backend::locked, ring_capacity, policy>::empty() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	return m_queue.empty();
 }
 
-template <typename type>
-std::size_t concurrent_queue<type>::size() const {
-	read_lock r_lock(m_rw_lock);
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+std::size_t concurrent_queue<type, queue_backend::locked, ring_capacity, policy>::size() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	return m_queue.size();
 }
 
-template <typename type>
-void concurrent_queue<type>::clear() {
-	write_lock w_lock(m_rw_lock);
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+void concurrent_queue<type, queue_backend::locked, ring_capacity, policy>::clear() {
+	std::lock_guard<std::mutex> lock(m_mutex);
 
 	while (!m_queue.empty()) {
 		m_queue.pop();
 	}
 }
 
-template <typename type>
-bool concurrent_queue<type>::pop(type& value) {
-	write_lock w_lock(m_rw_lock);
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+bool concurrent_queue<type, queue_backend::locked, ring_capacity, policy>::pop(type& value) {
+	std::lock_guard<std::mutex> lock(m_mutex);
 
 	if (m_queue.empty()) {
 		return false;
@@ -74,9 +121,9 @@ bool concurrent_queue<type>::pop(type& value) {
 	}
 }
 
-template<typename type>
-bool concurrent_queue<type>::pop() {
-	write_lock w_lock(m_rw_lock);
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+bool concurrent_queue<type, queue_backend::locked, ring_capacity, policy>::pop() {
+	std::lock_guard<std::mutex> lock(m_mutex);
 
 	if (m_queue.empty()) {
 		return false;
@@ -87,9 +134,271 @@ bool concurrent_queue<type>::pop() {
 	}
 }
 
-template <typename type>
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
 template <typename... arguments>
-void concurrent_queue<type>::emplace(arguments&&... parameters) {
-	write_lock w_lock(m_rw_lock);
+bool concurrent_queue<type, queue_backend::locked, ring_capacity, policy>::emplace(arguments&&... parameters) {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_queue.emplace(std::forward<arguments>(parameters)...);
+	return true;
+}
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+template <typename factory_t>
+std::size_t concurrent_queue<type, queue_backend::locked, ring_capacity, policy>::emplace_batch(const std::size_t amount, factory_t& make_element) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (std::size_t i = 0; i < amount; ++i) {
+		m_queue.emplace(make_element());
+	}
+
+	return amount;
+}
+
+// ===== Ring buffer backend =====
+
+// Bounded MPMC queue based on per-cell sequence numbers (D. Vyukov's algorithm).
+// Producers and consumers only contend on their own position counter with a single CAS, never on a lock.
+// The cell sequence tells whether a cell is free for the producer of the current lap or filled for the consumer of the current lap.
+// Positions and cells are padded to cache lines, so producers, consumers and neighbouring cells don't falsely share cache lines.
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+class concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy> {
+	static_assert(ring_capacity >= 2 && (ring_capacity & (ring_capacity - 1)) == 0, "ring_capacity must be a power of two.");
+	// An element is built before a cell is claimed and moved in after: a claimed cell that never gets filled would stop every consumer.
+	static_assert(std::is_nothrow_move_constructible_v<type>, "Elements are moved into claimed cells, type has to be nothrow move constructible.");
+
+	struct alignas(cache_line_size) cell {
+		std::atomic<std::size_t>	sequence;
+		alignas(type) unsigned char	storage[sizeof(type)];
+	};
+
+public:
+	inline concurrent_queue();
+	inline ~concurrent_queue() { clear(); }
+
+public:
+	inline bool empty() const;
+	inline std::size_t size() const;
+	inline constexpr std::size_t capacity() const { return ring_capacity; }
+
+	inline void clear();
+	inline bool pop(type& value);
+	inline bool pop();
+
+	// Returns false only with full_queue_policy::reject when the queue is full.
+	template <typename... arguments>
+	inline bool emplace(arguments&&... parameters);
+
+	// Never waits: returns false if the queue is full (the element is built from the arguments either way).
+	template <typename... arguments>
+	inline bool try_emplace(arguments&&... parameters);
+
+	// Adds amount elements returned by successive make_element() calls, one emplace each (there is no lock to batch).
+	// Returns the amount of added elements: with full_queue_policy::reject it stops at the first element that doesn't fit.
+	template <typename factory_t>
+	inline std::size_t emplace_batch(const std::size_t amount, factory_t& make_element);
+
+public:
+	inline concurrent_queue(const concurrent_queue& other) = delete;
+	inline concurrent_queue(concurrent_queue&& other) = delete;
+	inline concurrent_queue& operator=(const concurrent_queue& rhs) = delete;
+	inline concurrent_queue& operator=(concurrent_queue&& rhs) = delete;
+
+private:
+	// Moves element into a free cell. Returns false (element is left as it is) if the queue is full.
+	inline bool try_push(type& element);
+
+	inline type* claim_filled_cell(std::size_t& position);
+	inline void release_cell(const std::size_t position);
+
+	static constexpr std::size_t m_mask = ring_capacity - 1;
+
+	std::unique_ptr<cell[]> m_cells;
+
+	alignas(cache_line_size) std::atomic<std::size_t>	m_enqueue_position	= 0;
+	alignas(cache_line_size) std::atomic<std::size_t>	m_dequeue_position	= 0;
+
+	// Used only by full_queue_policy::block: producers sleep on m_released_cells until a consumer frees a cell.
+	alignas(cache_line_size) std::atomic<std::size_t>	m_blocked_producers	= 0;
+	std::atomic<std::uint32_t>							m_released_cells	= 0;
+};
+
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy>::concurrent_queue() : m_cells(new cell[ring_capacity]) {
+	for (std::size_t i = 0; i < ring_capacity; ++i) {
+		m_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+bool concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy>::empty() const {
+	return size() == 0;
+}
+
+// Approximate while producers and consumers are active.
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+std::size_t concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy>::size() const {
+	const std::size_t dequeue_position = m_dequeue_position.load(std::memory_order_relaxed);
+	const std::size_t enqueue_position = m_enqueue_position.load(std::memory_order_relaxed);
+
+	return enqueue_position > dequeue_position ? enqueue_position - dequeue_position : 0;
+}
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+void concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy>::clear() {
+	while (pop()) {}
+}
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+bool concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy>::pop(type& value) {
+	std::size_t position;
+	type* element = claim_filled_cell(position);
+
+	if (element == nullptr) {
+		return false;
+	}
+
+	value = std::move(*element);
+	element->~type();
+	release_cell(position);
+	return true;
+}
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+bool concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy>::pop() {
+	std::size_t position;
+	type* element = claim_filled_cell(position);
+
+	if (element == nullptr) {
+		return false;
+	}
+
+	element->~type();
+	release_cell(position);
+	return true;
+}
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+template <typename... arguments>
+bool concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy>::emplace(arguments&&... parameters) {
+	// The element is built once: try_push only moves from it when it has claimed a cell, so calling it again after a failure is safe.
+	type element(std::forward<arguments>(parameters)...);
+
+	if constexpr (policy == full_queue_policy::reject) {
+		return try_push(element);
+	}
+	else if constexpr (policy == full_queue_policy::spin) {
+		while (!try_push(element)) {
+			cpu_relax();
+		}
+		return true;
+	}
+	else {
+		if (try_push(element)) {
+			return true;
+		}
+
+		m_blocked_producers.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		while (true) {
+			const std::uint32_t released_cells = m_released_cells.load();
+
+			if (try_push(element)) {
+				break;
+			}
+
+			m_released_cells.wait(released_cells);
+		}
+
+		m_blocked_producers.fetch_sub(1);
+		return true;
+	}
+}
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+template <typename... arguments>
+bool concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy>::try_emplace(arguments&&... parameters) {
+	type element(std::forward<arguments>(parameters)...);
+	return try_push(element);
+}
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+bool concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy>::try_push(type& element) {
+	std::size_t position = m_enqueue_position.load(std::memory_order_relaxed);
+
+	while (true) {
+		cell& current_cell = m_cells[position & m_mask];
+		const std::size_t sequence = current_cell.sequence.load(std::memory_order_acquire);
+		const std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+
+		if (difference == 0) {
+			// The cell is free for this lap - claim it by moving the enqueue position forward.
+			if (m_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				::new (static_cast<void*>(current_cell.storage)) type(std::move(element));
+				current_cell.sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0) {
+			// The cell still holds an element of the previous lap - the queue is full.
+			return false;
+		}
+		else {
+			// Another producer has claimed this position already.
+			position = m_enqueue_position.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+template <typename factory_t>
+std::size_t concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy>::emplace_batch(const std::size_t amount, factory_t& make_element) {
+	for (std::size_t i = 0; i < amount; ++i) {
+		if (!emplace(make_element())) {
+			return i;
+		}
+	}
+
+	return amount;
+}
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+type* concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy>::claim_filled_cell(std::size_t& position) {
+	position = m_dequeue_position.load(std::memory_order_relaxed);
+
+	while (true) {
+		cell& current_cell = m_cells[position & m_mask];
+		const std::size_t sequence = current_cell.sequence.load(std::memory_order_acquire);
+		const std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+
+		if (difference == 0) {
+			if (m_dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				return std::launder(reinterpret_cast<type*>(current_cell.storage));
+			}
+		}
+		else if (difference < 0) {
+			// The cell hasn't been filled for this lap yet - the queue is empty.
+			return nullptr;
+		}
+		else {
+			position = m_dequeue_position.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template <typename type, std::size_t ring_capacity, full_queue_policy policy>
+void concurrent_queue<type, queue_backend::ring_buffer, ring_capacity, policy>::release_cell(const std::size_t position) {
+	// Mark the cell as free for the producer of the next lap.
+	m_cells[position & m_mask].sequence.store(position + ring_capacity, std::memory_order_release);
+
+	if constexpr (policy == full_queue_policy::block) {
+		// Pairs with the increment of m_blocked_producers: either the blocked producer sees the released cell, or we see the producer.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (m_blocked_producers.load(std::memory_order_relaxed) > 0) {
+			m_released_cells.fetch_add(1);
+			m_released_cells.notify_all();
+		}
+	}
 }
\ No newline at end of file
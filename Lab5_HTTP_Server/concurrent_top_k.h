@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "concurrent_queue.h"
+#include "top_k.h"
+
+// Counters of the slow path of concurrent_top_k (values rejected by the threshold aren't counted - that would make every insert
+// write to a shared cache line).
+struct concurrent_top_k_statistics {
+	std::uint64_t	replacements	= 0;	// Values that got in, replacing the smallest kept value.
+	std::uint64_t	late_rejections	= 0;	// Values that passed the threshold, but other producers had raised the smallest kept value meanwhile.
+	std::uint64_t	cas_failures	= 0;	// Failed compare-exchanges (a slot or the threshold changed by another producer), each one retried.
+};
+
+// The k largest values inserted by any amount of concurrent producers, without locks.
+// Every kept value has a slot of its own cache line, and slots only ever grow: a value gets in by replacing the smallest kept value
+// with one compare-exchange. threshold() - a lower bound of the smallest kept value - is read with a relaxed load, and rejects
+// almost every value of a long stream without writing anything. Insert batches where possible: a batch is narrowed to its own k
+// largest values first (see top_k_values), and the shared slots are only touched by those that beat the threshold.
+// Finding the smallest slot reads all k of them, so this is meant for a small k; for a large one use select_k.
+// Only values greater than floor are kept.
+template <typename T>
+class concurrent_top_k {
+public:
+	inline explicit concurrent_top_k(const std::size_t k, const T floor = std::numeric_limits<T>::lowest());
+
+	// Returns whether value got in.
+	inline bool insert(const T& value);
+
+	// Returns how many values of [first, last) got in.
+	template <typename iterator_t>
+	inline std::size_t insert(const iterator_t first, const iterator_t last);
+
+	// A value not greater than this would not get in. Never decreases.
+	inline T threshold() const { return m_threshold.load(std::memory_order_relaxed); }
+
+	inline std::size_t k() const { return m_k; }
+
+	// The kept values, the largest first (fewer than k if fewer values greater than floor were inserted).
+	// Exact once the producers are done; while they insert, a mix of the slots at slightly different moments.
+	inline std::vector<T> values_descending() const;
+
+	inline concurrent_top_k_statistics statistics() const;
+
+public:
+	inline concurrent_top_k(const concurrent_top_k& other) = delete;
+	inline concurrent_top_k& operator=(const concurrent_top_k& rhs) = delete;
+
+private:
+	inline bool replace_smallest(const T& value);
+	inline void raise_threshold(const T& smallest_kept);
+
+private:
+	struct alignas(cache_line_size) padded_slot {
+		std::atomic<T> value;
+	};
+
+	static_assert(std::atomic<T>::is_always_lock_free, "The slots are compare-exchanged, T has to be lock-free atomic.");
+
+	const std::size_t									m_k;
+	const T												m_floor;
+	std::unique_ptr<padded_slot[]>						m_slots;
+
+	alignas(cache_line_size) std::atomic<T>				m_threshold;
+
+	alignas(cache_line_size) std::atomic<std::uint64_t>	m_replacements		= 0;
+	std::atomic<std::uint64_t>							m_late_rejections	= 0;
+	std::atomic<std::uint64_t>							m_cas_failures		= 0;
+};
+
+
+template <typename T>
+inline concurrent_top_k<T>::concurrent_top_k(const std::size_t k, const T floor)
+	: m_k(k), m_floor(floor), m_slots(std::make_unique<padded_slot[]>(k)), m_threshold(floor) {
+	for (std::size_t i = 0; i < m_k; ++i) {
+		m_slots[i].value.store(floor, std::memory_order_relaxed);
+	}
+}
+
+template <typename T>
+inline bool concurrent_top_k<T>::insert(const T& value) {
+	if (!(threshold() < value)) {
+		return false;
+	}
+
+	return replace_smallest(value);
+}
+
+template <typename T>
+template <typename iterator_t>
+inline std::size_t concurrent_top_k<T>::insert(const iterator_t first, const iterator_t last) {
+	top_k_values<T> candidates(m_k);
+	candidates.push(first, last);
+
+	std::size_t inserted = 0;
+
+	// Descending: once a candidate doesn't get in, the smaller ones wouldn't either (the kept values only grow).
+	for (const T& candidate : candidates.take_sorted()) {
+		if (!insert(candidate)) {
+			break;
+		}
+		++inserted;
+	}
+
+	return inserted;
+}
+
+template <typename T>
+inline bool concurrent_top_k<T>::replace_smallest(const T& value) {
+	if (m_k == 0) {
+		return false;
+	}
+
+	for (;;) {
+		// The smallest slot, and the smallest of the rest with value in its place - the new smallest kept value if it gets in.
+		std::size_t smallest_index = 0;
+		T smallest = m_slots[0].value.load(std::memory_order_relaxed);
+		T next_smallest = value;
+
+		for (std::size_t i = 1; i < m_k; ++i) {
+			const T contained = m_slots[i].value.load(std::memory_order_relaxed);
+
+			if (contained < smallest) {
+				next_smallest = (smallest < next_smallest ? smallest : next_smallest);
+				smallest = contained;
+				smallest_index = i;
+			}
+			else if (contained < next_smallest) {
+				next_smallest = contained;
+			}
+		}
+
+		if (!(smallest < value)) {
+			m_late_rejections.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		// Slots only grow, so if the smallest one still holds what was read, every other slot is still at least as large:
+		// the value replaced is the smallest kept one.
+		if (m_slots[smallest_index].value.compare_exchange_strong(smallest, value, std::memory_order_relaxed)) {
+			m_replacements.fetch_add(1, std::memory_order_relaxed);
+			raise_threshold(next_smallest);
+			return true;
+		}
+
+		m_cas_failures.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+template <typename T>
+inline void concurrent_top_k<T>::raise_threshold(const T& smallest_kept) {
+	// smallest_kept may be already outdated, but only too small - the slots only grow.
+	T current = m_threshold.load(std::memory_order_relaxed);
+
+	while (current < smallest_kept) {
+		if (m_threshold.compare_exchange_weak(current, smallest_kept, std::memory_order_relaxed)) {
+			return;
+		}
+		m_cas_failures.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+template <typename T>
+inline std::vector<T> concurrent_top_k<T>::values_descending() const {
+	std::vector<T> values;
+	values.reserve(m_k);
+
+	for (std::size_t i = 0; i < m_k; ++i) {
+		const T contained = m_slots[i].value.load(std::memory_order_relaxed);
+		if (m_floor < contained) {
+			values.push_back(contained);
+		}
+	}
+
+	std::sort(values.begin(), values.end(), std::greater<T>());
+	return values;
+}
+
+template <typename T>
+inline concurrent_top_k_statistics concurrent_top_k<T>::statistics() const {
+	concurrent_top_k_statistics statistics;
+	statistics.replacements		= m_replacements.load(std::memory_order_relaxed);
+	statistics.late_rejections	= m_late_rejections.load(std::memory_order_relaxed);
+	statistics.cas_failures		= m_cas_failures.load(std::memory_order_relaxed);
+
+	return statistics;
+}
\ No newline at end of file
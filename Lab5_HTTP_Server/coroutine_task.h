@@ -0,0 +1,244 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "task_future.h"
+#include "thread_pool.h"
+
+template <typename result_t = void>
+class task;
+
+// Common part of the promises of task<result_t>. A task starts suspended and, when it finishes, transfers control straight
+// to the coroutine awaiting it (symmetric transfer), so long chains of co_await never grow the stack.
+// The coroutine frames are allocated from task_memory_pool, like the queued tasks themselves.
+class task_promise_base {
+	struct final_awaiter {
+		inline bool await_ready() const noexcept { return false; }
+
+		template <typename promise_t>
+		inline std::coroutine_handle<> await_suspend(const std::coroutine_handle<promise_t> coroutine) const noexcept {
+			const std::coroutine_handle<> continuation = coroutine.promise().m_continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+
+		inline void await_resume() const noexcept {}
+	};
+
+public:
+	inline static void* operator new(const std::size_t size) { return task_memory_pool::allocate(size); }
+	inline static void operator delete(void* const block, const std::size_t size) { task_memory_pool::deallocate(block, size); }
+
+	inline std::suspend_always initial_suspend() const noexcept { return {}; }
+	inline final_awaiter final_suspend() const noexcept { return {}; }
+	inline void unhandled_exception() noexcept { m_exception = std::current_exception(); }
+
+	inline void set_continuation(const std::coroutine_handle<> continuation) noexcept { m_continuation = continuation; }
+
+protected:
+	std::coroutine_handle<>	m_continuation;
+	std::exception_ptr		m_exception;
+};
+
+template <typename result_t>
+class task_promise : public task_promise_base {
+	static_assert(!std::is_reference_v<result_t>, "task<result_t>: return a pointer or a std::reference_wrapper instead of a reference.");
+
+public:
+	inline task<result_t> get_return_object() noexcept;
+
+	template <typename value_t>
+	inline void return_value(value_t&& value) { m_value.emplace(std::forward<value_t>(value)); }
+
+	// Returns the value of the finished coroutine or rethrows the exception it ended with.
+	inline result_t take_result();
+
+private:
+	std::optional<result_t> m_value;
+};
+
+template <>
+class task_promise<void> : public task_promise_base {
+public:
+	inline task<void> get_return_object() noexcept;
+
+	inline void return_void() const noexcept {}
+
+	inline void take_result();
+};
+
+// Lazily started coroutine returning result_t: it runs only when it is co_awaited (or handed to spawn / sync_wait), and the awaiting
+// coroutine is resumed right where it finishes. Move-only; destroying a task that has never been started destroys its frame.
+// Combined with co_await pool.schedule() and co_await reactor.readable(socket), one connection is a coroutine suspended at no cost
+// while it waits, instead of a worker blocked in recv.
+template <typename result_t>
+class [[nodiscard]] task {
+public:
+	using promise_type = task_promise<result_t>;
+
+public:
+	inline task() noexcept = default;
+	inline explicit task(const std::coroutine_handle<promise_type> coroutine) noexcept : m_coroutine(coroutine) {}
+	inline ~task() { reset(); }
+
+	inline task(task&& other) noexcept : m_coroutine(std::exchange(other.m_coroutine, nullptr)) {}
+	inline task& operator=(task&& rhs) noexcept;
+
+public:
+	inline bool valid() const noexcept { return static_cast<bool>(m_coroutine); }
+
+	// co_await std::move(t) starts the task on the current thread and gives its result (or rethrows its exception).
+	inline auto operator co_await() && noexcept;
+
+public:
+	inline task(const task& other) = delete;
+	inline task& operator=(const task& rhs) = delete;
+
+private:
+	inline void reset() noexcept;
+
+	std::coroutine_handle<promise_type> m_coroutine;
+};
+
+// Starts the task on the calling thread (it runs until its first suspension) and returns the future of its result.
+// The task keeps running on its own when the future is dropped, so spawn(serve_client(...)) is a fire-and-forget connection handler.
+template <typename result_t>
+inline task_future<result_t> spawn(task<result_t> started);
+
+// Same as spawn, but the task starts on a worker of pool instead of the calling thread.
+template <typename result_t>
+inline task_future<result_t> spawn(thread_pool& pool, task<result_t> started);
+
+// Runs the task and blocks the calling thread until it is done. Must not be called from a worker of the pool the task resumes on
+// if that pool may have no other worker left to resume it.
+template <typename result_t>
+inline result_t sync_wait(task<result_t> started);
+
+
+template <typename result_t>
+inline task<result_t> task_promise<result_t>::get_return_object() noexcept {
+	return task<result_t>(std::coroutine_handle<task_promise>::from_promise(*this));
+}
+
+template <typename result_t>
+inline result_t task_promise<result_t>::take_result() {
+	if (m_exception) {
+		std::rethrow_exception(m_exception);
+	}
+
+	return std::move(*m_value);
+}
+
+inline task<void> task_promise<void>::get_return_object() noexcept {
+	return task<void>(std::coroutine_handle<task_promise>::from_promise(*this));
+}
+
+inline void task_promise<void>::take_result() {
+	if (m_exception) {
+		std::rethrow_exception(m_exception);
+	}
+}
+
+template <typename result_t>
+inline task<result_t>& task<result_t>::operator=(task&& rhs) noexcept {
+	if (this != &rhs) {
+		reset();
+		m_coroutine = std::exchange(rhs.m_coroutine, nullptr);
+	}
+
+	return *this;
+}
+
+template <typename result_t>
+inline void task<result_t>::reset() noexcept {
+	if (m_coroutine) {
+		std::exchange(m_coroutine, nullptr).destroy();
+	}
+}
+
+template <typename result_t>
+inline auto task<result_t>::operator co_await() && noexcept {
+	struct awaiter {
+		inline bool await_ready() const noexcept { return !coroutine || coroutine.done(); }
+
+		inline std::coroutine_handle<> await_suspend(const std::coroutine_handle<> awaiting) const noexcept {
+			coroutine.promise().set_continuation(awaiting);
+			return coroutine;
+		}
+
+		inline result_t await_resume() const {
+			if (!coroutine) {
+				throw std::future_error(std::future_errc::no_state);
+			}
+
+			return coroutine.promise().take_result();
+		}
+
+		std::coroutine_handle<promise_type> coroutine;
+	};
+
+	return awaiter{ m_coroutine };
+}
+
+// Coroutine that owns itself: it starts immediately and its frame is freed as soon as it finishes. Used by spawn to drive a task.
+class detached_coroutine {
+public:
+	struct promise_type {
+		inline static void* operator new(const std::size_t size) { return task_memory_pool::allocate(size); }
+		inline static void operator delete(void* const block, const std::size_t size) { task_memory_pool::deallocate(block, size); }
+
+		inline detached_coroutine get_return_object() const noexcept { return {}; }
+		inline std::suspend_never initial_suspend() const noexcept { return {}; }
+		inline std::suspend_never final_suspend() const noexcept { return {}; }
+		inline void return_void() const noexcept {}
+		inline void unhandled_exception() const noexcept { std::terminate(); }
+	};
+};
+
+template <typename result_t>
+inline detached_coroutine run_detached(task<result_t> started, thread_pool* const pool, task_state<result_t>* const state) {
+	try {
+		if (pool != nullptr) {
+			co_await pool->schedule();
+		}
+
+		if constexpr (std::is_void_v<result_t>) {
+			co_await std::move(started);
+			state->set_value();
+		}
+		else {
+			state->set_value(co_await std::move(started));
+		}
+	}
+	catch (...) {
+		state->set_exception(std::current_exception());
+	}
+
+	state->release();
+}
+
+template <typename result_t>
+inline task_future<result_t> spawn(task<result_t> started) {
+	task_state<result_t>* const state = new task_state<result_t>();
+	run_detached(std::move(started), nullptr, state);
+
+	return task_future<result_t>(state);
+}
+
+template <typename result_t>
+inline task_future<result_t> spawn(thread_pool& pool, task<result_t> started) {
+	task_state<result_t>* const state = new task_state<result_t>();
+	run_detached(std::move(started), &pool, state);
+
+	return task_future<result_t>(state);
+}
+
+template <typename result_t>
+inline result_t sync_wait(task<result_t> started) {
+	return spawn(std::move(started)).get();
+}
\ No newline at end of file
@@ -15,6 +15,7 @@
 #pragma comment(lib, "ws2_32.lib")
 
 #include "files_hash_table.h"
+#include "trace_recorder.h"
 
 class http_server {
 public:
@@ -84,8 +85,14 @@ inline void http_server::init_server(const std::string& ip_address, const int po
 }
 
 inline void http_server::serve_client(SOCKET client_socket) const {
+	// Phases of the request, recorded while trace_recorder is started (see main.cpp, --trace).
 	std::string get_request(1024, '\0');
-	recv(client_socket, const_cast<char*>(get_request.data()), get_request.size(), 0);
+	{
+		const trace_scope recv_trace("recv", "http_server", client_socket);
+		recv(client_socket, const_cast<char*>(get_request.data()), get_request.size(), 0);
+	}
+
+	trace_scope process_trace("process", "http_server", client_socket);
 
 	std::stringstream sstream(std::string(get_request.begin(), std::find(get_request.begin(), get_request.end(), '\n')));
 	std::string path;
@@ -114,6 +121,9 @@ inline void http_server::serve_client(SOCKET client_socket) const {
 			+ file_to_content_umap[error404_page_path];
 	}
 
+	process_trace.finish();
+
+	const trace_scope send_trace("send", "http_server", client_socket);
 	send(client_socket, http_response.c_str(), http_response.size(), 0);
 
 	closesocket(client_socket);
@@ -1,11 +1,30 @@
 #include <iostream>
+#include <string>
 
 #include "http_server.h"
 #include "thread_pool.h"
+#include "trace_recorder.h"
+
+// The pool of thread_pool with the trace points compiled in: while the recorder is off they cost a relaxed load per task.
+using clients_pool = basic_thread_pool<pool_policies<selectable_queue, selectable_wait, false, false, continuous_phases, true>>;
 
 int main(int argc, char* argv[]) {
-	thread_pool clients_thead_pool;
-	clients_thead_pool.initialize(std::thread::hardware_concurrency());
+	for (int i = 1; i + 1 < argc; ++i) {
+		// --trace <file>: records the requests and the tasks of the pool; every Enter on the console writes them to file as Chrome trace JSON.
+		if (std::string(argv[i]) == "--trace") {
+			trace_recorder::get().write_on_enter(argv[i + 1]);
+		}
+	}
+
+	// Clients spend most of their time blocked in recv/send, so the pool grows past the core count under load and shrinks back when idle.
+	const std::size_t cores_amount = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+
+	elastic_limits clients_pool_limits;
+	clients_pool_limits.min_workers = 2;
+	clients_pool_limits.max_workers = 4 * cores_amount;
+
+	clients_pool clients_thead_pool(scheduling_mode::work_stealing, wait_strategy::hybrid());
+	clients_thead_pool.initialize(clients_pool_limits);
 	
 	http_server::init_protocol_and_load_files();
 
@@ -24,6 +43,7 @@ int main(int argc, char* argv[]) {
 		while (client_socket = accept(server.get_socket(), (sockaddr*)&client_addr, &client_addr_size)) {
 			//std::thread client_thread(&http_server::serve_client, &server, client_socket);
 			//client_thread.detach();
+			trace_recorder::get().record("accept", "http_server", trace_phase::instant, client_socket);
 			clients_thead_pool.add_task(&http_server::serve_client, &server, client_socket);
 		}
 	}
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+
+// Chunk bookkeeping of one parallel_for / parallel_reduce call, shared by the calling thread and the helper tasks.
+// Participants claim chunks from a shared counter until they run out (so faster participants simply take more chunks), and the caller
+// waits until remaining_chunks drops to zero. The chunks may be split into contiguous groups (one per NUMA node of the pool):
+// a participant drains the group of its own node first and only then helps with the others, so the same part of a range
+// is processed on the same node by every call. The state is reference counted because a helper task may start only after all chunks
+// are done and the call has returned - such a helper touches nothing but this state. The body and the partial results of a call
+// are only used by participants that have claimed a chunk, i.e. while the caller is still waiting.
+class parallel_chunks {
+public:
+	inline explicit parallel_chunks(const std::size_t chunks_amount, const std::size_t groups_amount = 1);
+
+public:
+	// Runs chunk_body(chunk_index) for every chunk the current thread manages to claim, starting with the chunks of home_group.
+	// After a chunk has thrown, the remaining chunks are claimed but skipped.
+	template <typename chunk_body_t>
+	inline void run(const chunk_body_t& chunk_body, const std::size_t home_group = 0);
+
+	// Waits until every chunk is done, then rethrows the first exception thrown by a chunk (if any).
+	inline void wait();
+
+private:
+	// Groups are claimed by participants of different nodes, so every counter gets its own cache line.
+	struct alignas(cache_line_size) chunk_group {
+		std::atomic<std::size_t>	next_chunk	= 0;
+		std::size_t					end_chunk	= 0;
+	};
+
+	const std::size_t									m_groups_amount;
+	std::unique_ptr<chunk_group[]>						m_groups;
+	alignas(cache_line_size) std::atomic<std::size_t>	m_remaining_chunks;
+
+	std::atomic<bool>	m_failed = false;
+	std::exception_ptr	m_exception;
+};
+
+// How many chunks every participant gets on average. More chunks balance uneven chunk costs better, fewer cost less bookkeeping.
+constexpr std::size_t parallel_chunks_per_participant = 4;
+
+// Calls body(chunk_first, chunk_last) for consecutive chunks covering [first, last) on the workers of pool and the calling thread,
+// and returns when all of them are done. first and last are integers or random access iterators.
+// grain is the minimal chunk length: chunks are never shorter (except the last one), but are made longer when the range is big enough
+// to give every participant parallel_chunks_per_participant chunks. An exception thrown by body is rethrown here.
+// The calling thread takes chunks too, so it is safe to call parallel_for from inside a task of the same pool.
+template <typename index_t, typename body_t>
+inline void parallel_for(thread_pool& pool, const index_t first, const index_t last, const std::size_t grain, const body_t& body);
+
+// Reduces [first, last) the same way: every participant folds the chunks it takes into its own partial value with
+// partial = reduce_chunk(chunk_first, chunk_last, std::move(partial)), starting from identity, and the partial values are then
+// merged on the calling thread with combine(std::move(result), std::move(partial)).
+// Chunks are assigned to participants dynamically, so reduce_chunk and combine must give the same result in any order.
+template <typename index_t, typename value_t, typename reduce_chunk_t, typename combine_t>
+inline value_t parallel_reduce(thread_pool& pool, const index_t first, const index_t last, const std::size_t grain, const value_t& identity, const reduce_chunk_t& reduce_chunk, const combine_t& combine);
+
+// Sorts [first, last) (random access iterators) by compare: a block per participant is sorted with std::sort, then neighbouring
+// blocks are merged pairwise, the merges of one round in parallel - log2(participants) rounds, the last one a single merge.
+// Not stable. Ranges shorter than two grains are sorted on the calling thread.
+template <typename iterator_t, typename compare_t>
+inline void parallel_sort(thread_pool& pool, const iterator_t first, const iterator_t last, const compare_t& compare, const std::size_t grain);
+
+// Chunk length used by parallel_for and parallel_reduce for a range of size elements.
+inline std::size_t parallel_chunk_size(const std::size_t size, const std::size_t grain, const std::size_t participants);
+
+// Splits chunks_amount chunks between the calling thread (participant 0) and up to participants - 1 helper tasks of pool
+// and calls participant_body(participant, chunk_index) for every chunk. With a NUMA-placed pool, chunk groups follow pool.placement_groups().
+template <typename participant_body_t>
+inline void run_parallel_chunks(thread_pool& pool, const std::size_t chunks_amount, const std::size_t participants, const participant_body_t& participant_body);
+
+
+inline parallel_chunks::parallel_chunks(const std::size_t chunks_amount, const std::size_t groups_amount)
+	: m_groups_amount(groups_amount > 0 ? groups_amount : 1), m_groups(new chunk_group[m_groups_amount]), m_remaining_chunks(chunks_amount) {
+	for (std::size_t group = 0; group < m_groups_amount; ++group) {
+		m_groups[group].next_chunk = group * chunks_amount / m_groups_amount;
+		m_groups[group].end_chunk = (group + 1) * chunks_amount / m_groups_amount;
+	}
+}
+
+template <typename chunk_body_t>
+inline void parallel_chunks::run(const chunk_body_t& chunk_body, const std::size_t home_group) {
+	std::size_t chunk_index = 0;
+
+	for (std::size_t offset = 0; offset < m_groups_amount; ++offset) {
+		chunk_group& group = m_groups[(home_group + offset) % m_groups_amount];
+
+		while ((chunk_index = group.next_chunk.fetch_add(1, std::memory_order_relaxed)) < group.end_chunk) {
+			if (!m_failed.load(std::memory_order_relaxed)) {
+				try {
+					chunk_body(chunk_index);
+				}
+				catch (...) {
+					if (!m_failed.exchange(true)) {
+						m_exception = std::current_exception();
+					}
+				}
+			}
+
+			if (m_remaining_chunks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				m_remaining_chunks.notify_all();
+			}
+		}
+	}
+}
+
+inline void parallel_chunks::wait() {
+	std::size_t remaining_chunks = 0;
+
+	while ((remaining_chunks = m_remaining_chunks.load(std::memory_order_acquire)) != 0) {
+		m_remaining_chunks.wait(remaining_chunks, std::memory_order_acquire);
+	}
+
+	if (m_exception) {
+		std::rethrow_exception(m_exception);
+	}
+}
+
+inline std::size_t parallel_chunk_size(const std::size_t size, const std::size_t grain, const std::size_t participants) {
+	const std::size_t balanced_chunks	= participants * parallel_chunks_per_participant;
+	const std::size_t balanced_size		= (size + balanced_chunks - 1) / balanced_chunks;
+
+	if (balanced_size > grain) {
+		return balanced_size;
+	}
+
+	return grain > 0 ? grain : 1;
+}
+
+template <typename participant_body_t>
+inline void run_parallel_chunks(thread_pool& pool, const std::size_t chunks_amount, const std::size_t participants, const participant_body_t& participant_body) {
+	if (chunks_amount == 0) {
+		return;
+	}
+
+	const std::size_t groups_amount = pool.placement_groups();
+	auto chunks = std::make_shared<parallel_chunks>(chunks_amount, (groups_amount < chunks_amount ? groups_amount : chunks_amount));
+
+	if (participants > 1) {
+		// One helper task per participant instead of one task per chunk - the chunks are distributed through the shared counters.
+		pool.add_task_batch(participants - 1, [chunks, &pool, &participant_body](const std::size_t helper_index) {
+			chunks->run([&participant_body, helper_index](const std::size_t chunk_index) {
+				participant_body(helper_index + 1, chunk_index);
+			}, pool.placement_group_of_current_thread());
+		});
+	}
+
+	chunks->run([&participant_body](const std::size_t chunk_index) {
+		participant_body(0, chunk_index);
+	}, pool.placement_group_of_current_thread());
+
+	chunks->wait();
+}
+
+template <typename index_t, typename body_t>
+inline void parallel_for(thread_pool& pool, const index_t first, const index_t last, const std::size_t grain, const body_t& body) {
+	using offset_t = decltype(last - first);
+
+	const std::size_t max_participants = pool.worker_count() + 1;
+	const std::size_t size = (last > first ? static_cast<std::size_t>(last - first) : 0);
+	const std::size_t chunk_size = parallel_chunk_size(size, grain, max_participants);
+	const std::size_t chunks_amount = (size + chunk_size - 1) / chunk_size;
+	const std::size_t participants = (chunks_amount < max_participants ? chunks_amount : max_participants);
+
+	run_parallel_chunks(pool, chunks_amount, participants, [first, size, chunk_size, &body](const std::size_t, const std::size_t chunk_index) {
+		const std::size_t chunk_begin = chunk_index * chunk_size;
+		const std::size_t chunk_end = (size - chunk_begin < chunk_size ? size : chunk_begin + chunk_size);
+
+		body(first + static_cast<offset_t>(chunk_begin), first + static_cast<offset_t>(chunk_end));
+	});
+}
+
+template <typename index_t, typename value_t, typename reduce_chunk_t, typename combine_t>
+inline value_t parallel_reduce(thread_pool& pool, const index_t first, const index_t last, const std::size_t grain, const value_t& identity, const reduce_chunk_t& reduce_chunk, const combine_t& combine) {
+	using offset_t = decltype(last - first);
+
+	// Partial values of different participants are updated concurrently, so each one gets its own cache line(s).
+	struct alignas(cache_line_size) padded_partial {
+		value_t value;
+	};
+
+	const std::size_t max_participants = pool.worker_count() + 1;
+	const std::size_t size = (last > first ? static_cast<std::size_t>(last - first) : 0);
+	const std::size_t chunk_size = parallel_chunk_size(size, grain, max_participants);
+	const std::size_t chunks_amount = (size + chunk_size - 1) / chunk_size;
+	const std::size_t participants = (chunks_amount < max_participants ? chunks_amount : max_participants);
+
+	std::vector<padded_partial> partials(participants, padded_partial{ identity });
+
+	run_parallel_chunks(pool, chunks_amount, participants, [first, size, chunk_size, &partials, &reduce_chunk](const std::size_t participant, const std::size_t chunk_index) {
+		const std::size_t chunk_begin = chunk_index * chunk_size;
+		const std::size_t chunk_end = (size - chunk_begin < chunk_size ? size : chunk_begin + chunk_size);
+
+		value_t& partial = partials[participant].value;
+		partial = reduce_chunk(first + static_cast<offset_t>(chunk_begin), first + static_cast<offset_t>(chunk_end), std::move(partial));
+	});
+
+	value_t result = identity;
+	for (padded_partial& partial : partials) {
+		result = combine(std::move(result), std::move(partial.value));
+	}
+
+	return result;
+}
+
+template <typename iterator_t, typename compare_t>
+inline void parallel_sort(thread_pool& pool, const iterator_t first, const iterator_t last, const compare_t& compare, const std::size_t grain) {
+	const std::size_t size = (last > first ? static_cast<std::size_t>(last - first) : 0);
+	const std::size_t min_block = (grain > 0 ? grain : 1);
+	const std::size_t max_blocks = pool.worker_count() + 1;
+
+	const std::size_t blocks = (size / min_block < max_blocks ? size / min_block : max_blocks);
+	if (blocks < 2) {
+		std::sort(first, last, compare);
+		return;
+	}
+
+	const std::size_t block_size = (size + blocks - 1) / blocks;
+
+	auto block_end = [first, size](const std::size_t offset) {
+		return first + static_cast<std::ptrdiff_t>(offset < size ? offset : size);
+	};
+
+	parallel_for(pool, std::size_t(0), blocks, 1, [&](const std::size_t first_block, const std::size_t last_block) {
+		for (std::size_t block = first_block; block < last_block; ++block) {
+			std::sort(block_end(block * block_size), block_end((block + 1) * block_size), compare);
+		}
+	});
+
+	for (std::size_t width = block_size; width < size; width *= 2) {
+		const std::size_t pairs = (size + 2 * width - 1) / (2 * width);
+
+		parallel_for(pool, std::size_t(0), pairs, 1, [&](const std::size_t first_pair, const std::size_t last_pair) {
+			for (std::size_t pair = first_pair; pair < last_pair; ++pair) {
+				std::inplace_merge(block_end(2 * pair * width), block_end((2 * pair + 1) * width), block_end((2 * pair + 2) * width), compare);
+			}
+		});
+	}
+}
\ No newline at end of file
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "concurrent_queue.h"
+#include "unique_task.h"
+
+// Log-bucketed (HDR-style) histogram of durations in nanoseconds. Every power-of-two range is split into m_sub_buckets linear buckets,
+// so a value is reported with an error below 1 / m_sub_buckets (6.25%) whatever its magnitude, from 1 ns up to ~36 minutes (longer
+// durations are counted in the last bucket). One thread records, any thread may read at the same time: the counters are relaxed atomics
+// updated with a plain load and store, so recording costs no locked instruction.
+class latency_histogram {
+	static constexpr unsigned		m_sub_bucket_bits	= 4;
+	static constexpr std::uint64_t	m_sub_buckets		= std::uint64_t(1) << m_sub_bucket_bits;
+	static constexpr unsigned		m_value_bits		= 41;
+
+public:
+	static constexpr std::size_t bucket_count = m_sub_buckets + (m_value_bits - m_sub_bucket_bits) * m_sub_buckets;
+
+	using counts = std::array<std::uint64_t, bucket_count>;
+
+public:
+	inline void record(const std::uint64_t nanoseconds);
+
+	// Adds the counts of this histogram to merged (taken while the owner thread may still be recording).
+	inline void merge_into(counts& merged) const;
+
+	// The highest value of the bucket holding the given quantile (0.5 for the median) of the values counted in merged.
+	inline static std::uint64_t value_at_quantile(const counts& merged, const double quantile);
+
+private:
+	inline static std::size_t bucket_index(std::uint64_t nanoseconds);
+	inline static std::uint64_t bucket_upper_bound(const std::size_t index);
+
+	std::array<std::atomic<std::uint64_t>, bucket_count> m_counts{};
+};
+
+// Percentiles of one kind of duration over all workers of a pool.
+struct latency_summary {
+	std::uint64_t count		= 0;
+	std::uint64_t mean_ns	= 0;
+	std::uint64_t p50_ns	= 0;
+	std::uint64_t p90_ns	= 0;
+	std::uint64_t p99_ns	= 0;
+	std::uint64_t p999_ns	= 0;
+	std::uint64_t max_ns	= 0;
+};
+
+// Statistics of the tasks completed by a thread pool so far.
+struct thread_pool_snapshot {
+	std::uint64_t	completed_tasks			= 0;
+	double			average_queue_length	= 0.0;	// Queue length seen by the workers when they took a task.
+
+	latency_summary	wait;	// From add_task to the start of the task.
+	latency_summary	run;	// Execution of the task.
+};
+
+// Statistics of one worker, written only by that worker. Every worker has its own cache lines, so recording never contends.
+struct alignas(cache_line_size) worker_statistics {
+	inline void record_task(const std::uint64_t wait_ns, const std::uint64_t run_ns, const std::size_t queue_length);
+
+	std::atomic<std::uint64_t>	completed_tasks			= 0;
+	std::atomic<std::uint64_t>	sum_of_queue_lengths	= 0;
+	std::atomic<std::uint64_t>	total_wait_ns			= 0;
+	std::atomic<std::uint64_t>	total_run_ns			= 0;
+	std::atomic<std::uint64_t>	max_wait_ns				= 0;
+	std::atomic<std::uint64_t>	max_run_ns				= 0;
+
+	latency_histogram			wait;
+	latency_histogram			run;
+};
+
+// Merges the statistics of workers_amount workers.
+inline thread_pool_snapshot summarize_statistics(const worker_statistics* const statistics, const std::size_t workers_amount);
+
+// unique_task stamped with the time it was added to the queue - the queue element of a thread pool that collects statistics.
+struct timed_task {
+	inline timed_task() = default;
+
+	template <typename task_t, typename... arguments, typename = std::enable_if_t<!std::is_same_v<std::decay_t<task_t>, timed_task>>>
+	inline timed_task(task_t&& task_, arguments&&... parameters) : task(std::forward<task_t>(task_), std::forward<arguments>(parameters)...), enqueued_at(std::chrono::steady_clock::now()) {}
+
+	inline void operator()() { task(); }
+
+	unique_task								task;
+	std::chrono::steady_clock::time_point	enqueued_at;
+};
+
+
+// The counters have a single writer, so load + store is enough and cheaper than fetch_add.
+inline void add_relaxed(std::atomic<std::uint64_t>& counter, const std::uint64_t value) {
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline void max_relaxed(std::atomic<std::uint64_t>& counter, const std::uint64_t value) {
+	if (value > counter.load(std::memory_order_relaxed)) {
+		counter.store(value, std::memory_order_relaxed);
+	}
+}
+
+inline std::size_t latency_histogram::bucket_index(std::uint64_t nanoseconds) {
+	if (nanoseconds < m_sub_buckets) {
+		return static_cast<std::size_t>(nanoseconds);
+	}
+
+	if (nanoseconds >= (std::uint64_t(1) << m_value_bits)) {
+		nanoseconds = (std::uint64_t(1) << m_value_bits) - 1;
+	}
+
+	// The top m_sub_bucket_bits + 1 bits of the value select the bucket: the position of the highest bit picks the power-of-two range,
+	// the bits below it pick the linear sub-bucket.
+	const unsigned shift = static_cast<unsigned>(std::bit_width(nanoseconds)) - m_sub_bucket_bits - 1;
+	return static_cast<std::size_t>(m_sub_buckets + shift * m_sub_buckets + ((nanoseconds >> shift) - m_sub_buckets));
+}
+
+inline std::uint64_t latency_histogram::bucket_upper_bound(const std::size_t index) {
+	if (index < m_sub_buckets) {
+		return index;
+	}
+
+	const std::size_t shift = (index - m_sub_buckets) / m_sub_buckets;
+	const std::uint64_t sub_bucket = (index - m_sub_buckets) % m_sub_buckets;
+
+	return ((m_sub_buckets + sub_bucket + 1) << shift) - 1;
+}
+
+inline void latency_histogram::record(const std::uint64_t nanoseconds) {
+	add_relaxed(m_counts[bucket_index(nanoseconds)], 1);
+}
+
+inline void latency_histogram::merge_into(counts& merged) const {
+	for (std::size_t i = 0; i < bucket_count; ++i) {
+		merged[i] += m_counts[i].load(std::memory_order_relaxed);
+	}
+}
+
+inline std::uint64_t latency_histogram::value_at_quantile(const counts& merged, const double quantile) {
+	std::uint64_t total = 0;
+	for (const std::uint64_t count : merged) {
+		total += count;
+	}
+
+	if (total == 0) {
+		return 0;
+	}
+
+	std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(quantile * static_cast<double>(total)));
+	if (rank < 1) {
+		rank = 1;
+	}
+
+	std::uint64_t cumulative = 0;
+	for (std::size_t i = 0; i < bucket_count; ++i) {
+		cumulative += merged[i];
+
+		if (cumulative >= rank) {
+			return bucket_upper_bound(i);
+		}
+	}
+
+	return bucket_upper_bound(bucket_count - 1);
+}
+
+inline void worker_statistics::record_task(const std::uint64_t wait_ns, const std::uint64_t run_ns, const std::size_t queue_length) {
+	add_relaxed(completed_tasks, 1);
+	add_relaxed(sum_of_queue_lengths, queue_length);
+	add_relaxed(total_wait_ns, wait_ns);
+	add_relaxed(total_run_ns, run_ns);
+	max_relaxed(max_wait_ns, wait_ns);
+	max_relaxed(max_run_ns, run_ns);
+
+	wait.record(wait_ns);
+	run.record(run_ns);
+}
+
+inline thread_pool_snapshot summarize_statistics(const worker_statistics* const statistics, const std::size_t workers_amount) {
+	thread_pool_snapshot snapshot;
+
+	latency_histogram::counts wait_counts{};
+	latency_histogram::counts run_counts{};
+
+	std::uint64_t sum_of_queue_lengths = 0;
+	std::uint64_t total_wait_ns = 0;
+	std::uint64_t total_run_ns = 0;
+
+	for (std::size_t i = 0; i < workers_amount; ++i) {
+		const worker_statistics& worker = statistics[i];
+
+		snapshot.completed_tasks	+= worker.completed_tasks.load(std::memory_order_relaxed);
+		sum_of_queue_lengths		+= worker.sum_of_queue_lengths.load(std::memory_order_relaxed);
+		total_wait_ns				+= worker.total_wait_ns.load(std::memory_order_relaxed);
+		total_run_ns				+= worker.total_run_ns.load(std::memory_order_relaxed);
+
+		const std::uint64_t max_wait_ns = worker.max_wait_ns.load(std::memory_order_relaxed);
+		const std::uint64_t max_run_ns = worker.max_run_ns.load(std::memory_order_relaxed);
+		snapshot.wait.max_ns	= (max_wait_ns > snapshot.wait.max_ns ? max_wait_ns : snapshot.wait.max_ns);
+		snapshot.run.max_ns		= (max_run_ns > snapshot.run.max_ns ? max_run_ns : snapshot.run.max_ns);
+
+		worker.wait.merge_into(wait_counts);
+		worker.run.merge_into(run_counts);
+	}
+
+	if (snapshot.completed_tasks == 0) {
+		return snapshot;
+	}
+
+	snapshot.average_queue_length = static_cast<double>(sum_of_queue_lengths) / snapshot.completed_tasks;
+
+	auto summarize = [&snapshot](latency_summary& summary, const latency_histogram::counts& counts, const std::uint64_t total_ns) {
+		// A bucket bound may exceed the largest value actually recorded.
+		auto quantile = [&summary, &counts](const double q) {
+			const std::uint64_t value = latency_histogram::value_at_quantile(counts, q);
+			return (value < summary.max_ns ? value : summary.max_ns);
+		};
+
+		summary.count	= snapshot.completed_tasks;
+		summary.mean_ns	= total_ns / snapshot.completed_tasks;
+		summary.p50_ns	= quantile(0.5);
+		summary.p90_ns	= quantile(0.9);
+		summary.p99_ns	= quantile(0.99);
+		summary.p999_ns	= quantile(0.999);
+	};
+
+	summarize(snapshot.wait, wait_counts, total_wait_ns);
+	summarize(snapshot.run, run_counts, total_run_ns);
+
+	return snapshot;
+}
\ No newline at end of file
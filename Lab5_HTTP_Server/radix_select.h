@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "parallel_algorithms.h"
+
+// Bits of the key one pass of radix_select ranks by: a histogram of 2^11 counters (16 KB) stays in the L1 cache of its participant.
+constexpr unsigned radix_select_digit_bits = 11;
+
+// Items a chunk buffers before reserving their place in the shared output with a single fetch_add.
+constexpr std::size_t radix_select_flush_size = 256;
+
+// Element types radix_select can rank by their bits.
+template <typename T>
+concept radix_selectable = (std::is_integral_v<T> && !std::is_same_v<T, bool>) || std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+template <typename T>
+struct radix_key_traits { using type = std::make_unsigned_t<T>; };
+template <>
+struct radix_key_traits<float> { using type = std::uint32_t; };
+template <>
+struct radix_key_traits<double> { using type = std::uint64_t; };
+
+template <typename T>
+using radix_key = typename radix_key_traits<T>::type;
+
+// Unsigned key ordered like the values: the sign bit of a signed integer is flipped; a negative floating point value has all its bits
+// flipped (the larger its bits, the smaller it is), a positive one - only the sign bit. -0.0 gets the key of +0.0, as they compare equal.
+template <radix_selectable T>
+inline radix_key<T> radix_order_key(const T value);
+
+// Rank of value in the selection - the larger, the earlier selected. A NaN gets 0, which no number has (only a NaN has that key),
+// so NaNs are reached only once every number is selected, and are then left out like top_k_values does.
+template <bool largest, radix_selectable T>
+inline radix_key<T> radix_rank(const T value);
+
+// The k largest (largest = true) or k smallest values of [values, values + size), in no particular order (all of them if there are fewer).
+// NaNs are left out, and -0.0 ranks equal to +0.0 (see radix_rank), like with top_k_values.
+// Instead of comparing values, every pass counts the values by the next radix_select_digit_bits bits of their keys, starting from the top:
+// each participant fills a histogram of its own chunks, the histograms are summed, and the bucket where the selection ends (the pivot)
+// is found. The values of the buckets before it are selected whole, the values of the pivot bucket are collected as candidates
+// for the next pass over the lower bits, until the selection is exact. The first pass reads the whole range twice (count, then collect),
+// the next ones only the candidates, so the cost hardly depends on k - unlike top_k_values, which pays O(log k) per kept value.
+template <bool largest, radix_selectable T>
+inline std::vector<T> radix_select(thread_pool& pool, const T* const values, const std::size_t size, const std::size_t k, const std::size_t grain);
+
+// Positions in values of the selected values instead of the values, in no particular order.
+// Of the values equal to the last selected one, those with the smallest positions are selected.
+template <bool largest, radix_selectable T>
+inline std::vector<std::size_t> radix_select_indices(thread_pool& pool, const T* const values, const std::size_t size, const std::size_t k, const std::size_t grain);
+
+
+template <radix_selectable T>
+inline radix_key<T> radix_order_key(const T value) {
+	using key_t = radix_key<T>;
+	constexpr key_t sign_bit = key_t(key_t(1) << (sizeof(key_t) * CHAR_BIT - 1));
+
+	if constexpr (std::is_floating_point_v<T>) {
+		const key_t bits = std::bit_cast<key_t>(value == T(0) ? T(0) : value);
+		return (bits & sign_bit) != 0 ? key_t(~bits) : key_t(bits | sign_bit);
+	}
+	else if constexpr (std::is_signed_v<T>) {
+		return key_t(static_cast<key_t>(value) ^ sign_bit);
+	}
+	else {
+		return value;
+	}
+}
+
+template <bool largest, radix_selectable T>
+inline radix_key<T> radix_rank(const T value) {
+	if constexpr (std::is_floating_point_v<T>) {
+		if (value != value) {
+			return 0;
+		}
+	}
+
+	return largest ? radix_order_key(value) : radix_key<T>(~radix_order_key(value));
+}
+
+// One pass over item_at(0), ..., item_at(size - 1), whose keys (key_of) all share the bits above shift + radix_select_digit_bits:
+// the items of the buckets above the pivot one are appended to selected, the items of the pivot bucket to candidates (unless all of them
+// are selected too). remaining - how many items are still to be selected, at most size. Returns how many of the candidates still are.
+template <typename key_t, typename item_t, typename item_at_t, typename key_of_t>
+inline std::size_t radix_select_pass(thread_pool& pool, const std::size_t size, const item_at_t& item_at, const key_of_t& key_of, const unsigned shift,
+	const std::size_t remaining, std::vector<item_t>& selected, std::vector<item_t>& candidates, const std::size_t grain) {
+	using histogram = std::vector<std::size_t>;
+
+	constexpr std::size_t buckets = std::size_t(1) << radix_select_digit_bits;
+
+	auto digit = [shift](const key_t key) {
+		return static_cast<std::size_t>(key >> shift) & (buckets - 1);
+	};
+
+	const histogram counts = parallel_reduce(pool, std::size_t(0), size, grain, histogram(buckets, 0),
+		[&item_at, &key_of, &digit](const std::size_t chunk_first, const std::size_t chunk_last, histogram partial) {
+			for (std::size_t i = chunk_first; i < chunk_last; ++i) {
+				++partial[digit(key_of(item_at(i)))];
+			}
+			return partial;
+		},
+		[](histogram result, const histogram& partial) {
+			for (std::size_t bucket = 0; bucket < buckets; ++bucket) {
+				result[bucket] += partial[bucket];
+			}
+			return result;
+		});
+
+	// The largest keys are selected first.
+	std::size_t pivot = buckets - 1;
+	std::size_t above = 0;
+
+	while (above + counts[pivot] < remaining) {
+		above += counts[pivot];
+		--pivot;
+	}
+
+	const std::size_t pivot_remaining = remaining - above;
+	const bool whole_pivot = (pivot_remaining == counts[pivot]);
+
+	const std::size_t selected_first = selected.size();
+	selected.resize(selected_first + above + (whole_pivot ? counts[pivot] : 0));
+	candidates.resize(whole_pivot ? 0 : counts[pivot]);
+
+	std::atomic<std::size_t> selected_end = selected_first;
+	std::atomic<std::size_t> candidates_end = 0;
+
+	parallel_for(pool, std::size_t(0), size, grain, [&](const std::size_t chunk_first, const std::size_t chunk_last) {
+		item_t selected_buffer[radix_select_flush_size];
+		item_t candidates_buffer[radix_select_flush_size];
+		std::size_t selected_buffered = 0;
+		std::size_t candidates_buffered = 0;
+
+		auto flush = [](const item_t* const buffer, std::size_t& buffered, std::vector<item_t>& output, std::atomic<std::size_t>& output_end) {
+			const std::size_t position = output_end.fetch_add(buffered, std::memory_order_relaxed);
+			std::copy(buffer, buffer + buffered, output.begin() + static_cast<std::ptrdiff_t>(position));
+			buffered = 0;
+		};
+
+		for (std::size_t i = chunk_first; i < chunk_last; ++i) {
+			const item_t item = item_at(i);
+			const std::size_t bucket = digit(key_of(item));
+
+			if (bucket > pivot || (whole_pivot && bucket == pivot)) {
+				selected_buffer[selected_buffered++] = item;
+				if (selected_buffered == radix_select_flush_size) {
+					flush(selected_buffer, selected_buffered, selected, selected_end);
+				}
+			}
+			else if (bucket == pivot) {
+				candidates_buffer[candidates_buffered++] = item;
+				if (candidates_buffered == radix_select_flush_size) {
+					flush(candidates_buffer, candidates_buffered, candidates, candidates_end);
+				}
+			}
+		}
+
+		flush(selected_buffer, selected_buffered, selected, selected_end);
+		flush(candidates_buffer, candidates_buffered, candidates, candidates_end);
+	});
+
+	return whole_pivot ? 0 : pivot_remaining;
+}
+
+// The k items of item_at(0), ..., item_at(size - 1) with the largest keys; of the items with the key of the last selected one,
+// the smallest items are taken (the smallest positions, when the items are positions).
+template <typename key_t, typename item_t, typename item_at_t, typename key_of_t>
+inline std::vector<item_t> radix_select_items(thread_pool& pool, const std::size_t size, const item_at_t& item_at, const key_of_t& key_of,
+	const std::size_t k, const std::size_t grain) {
+	constexpr unsigned key_bits = sizeof(key_t) * CHAR_BIT;
+
+	std::vector<item_t> selected;
+	std::vector<item_t> candidates;
+	std::vector<item_t> next_candidates;
+
+	const std::size_t amount = (k < size ? k : size);
+	if (amount == 0) {
+		return selected;
+	}
+
+	selected.reserve(amount);
+
+	// The lowest pass may overlap the bits of the previous one, which the candidates already share.
+	unsigned shift = (key_bits > radix_select_digit_bits ? key_bits - radix_select_digit_bits : 0);
+	std::size_t remaining = radix_select_pass<key_t>(pool, size, item_at, key_of, shift, amount, selected, candidates, grain);
+
+	while (remaining > 0 && shift > 0) {
+		shift = (shift > radix_select_digit_bits ? shift - radix_select_digit_bits : 0);
+
+		remaining = radix_select_pass<key_t>(pool, candidates.size(), [&candidates](const std::size_t i) { return candidates[i]; }, key_of, shift,
+			remaining, selected, next_candidates, grain);
+		candidates.swap(next_candidates);
+	}
+
+	// Every key bit is used up: the candidates left all have the same key.
+	if (remaining > 0) {
+		std::nth_element(candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(remaining - 1), candidates.end());
+		selected.insert(selected.end(), candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(remaining));
+	}
+
+	return selected;
+}
+
+template <bool largest, radix_selectable T>
+inline std::vector<T> radix_select(thread_pool& pool, const T* const values, const std::size_t size, const std::size_t k, const std::size_t grain) {
+	std::vector<T> selected = radix_select_items<radix_key<T>, T>(pool, size,
+		[values](const std::size_t i) { return values[i]; },
+		[](const T value) { return radix_rank<largest>(value); },
+		k, grain);
+
+	if constexpr (std::is_floating_point_v<T>) {
+		std::erase_if(selected, [](const T value) { return value != value; });
+	}
+
+	return selected;
+}
+
+template <bool largest, radix_selectable T>
+inline std::vector<std::size_t> radix_select_indices(thread_pool& pool, const T* const values, const std::size_t size, const std::size_t k, const std::size_t grain) {
+	std::vector<std::size_t> selected = radix_select_items<radix_key<T>, std::size_t>(pool, size,
+		[](const std::size_t i) { return i; },
+		[values](const std::size_t i) { return radix_rank<largest>(values[i]); },
+		k, grain);
+
+	if constexpr (std::is_floating_point_v<T>) {
+		std::erase_if(selected, [values](const std::size_t i) { return values[i] != values[i]; });
+	}
+
+	return selected;
+}
\ No newline at end of file
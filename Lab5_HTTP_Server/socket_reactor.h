@@ -0,0 +1,162 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <coroutine>
+#include <cstdint>
+#include <system_error>
+#include <thread>
+
+#include "thread_pool.h"
+
+// Awaitable readiness of sockets (or any other epoll-able descriptors): co_await reactor.readable(socket) suspends the coroutine
+// until the socket has data to read (or is closed, or has failed) and resumes it on a worker of the pool. One thread waits on
+// one epoll instance for every suspended coroutine, so connections that are idle cost a coroutine frame, not a blocked thread.
+// At most one coroutine may wait on a given socket at a time. Coroutines still waiting when the reactor is destroyed are never
+// resumed, so the reactor must outlive the connections it serves.
+class socket_reactor {
+public:
+	class readiness_awaiter {
+	public:
+		inline readiness_awaiter(socket_reactor& reactor, const int socket, const std::uint32_t events) noexcept : m_reactor(reactor), m_socket(socket), m_events(events) {}
+
+		inline bool await_ready() const noexcept { return false; }
+		inline void await_suspend(const std::coroutine_handle<> coroutine);
+
+		// The epoll events the socket was reported with (EPOLLIN / EPOLLOUT, possibly with EPOLLHUP or EPOLLERR).
+		inline std::uint32_t await_resume() const noexcept { return m_events; }
+
+	private:
+		friend class socket_reactor;
+
+		socket_reactor&			m_reactor;
+		const int				m_socket;
+		std::uint32_t			m_events;
+		std::coroutine_handle<>	m_coroutine;
+	};
+
+public:
+	// Throws std::system_error if the epoll instance can't be created.
+	inline explicit socket_reactor(thread_pool& pool);
+	inline ~socket_reactor();
+
+public:
+	inline readiness_awaiter readable(const int socket) noexcept { return readiness_awaiter(*this, socket, EPOLLIN | EPOLLRDHUP); }
+	inline readiness_awaiter writable(const int socket) noexcept { return readiness_awaiter(*this, socket, EPOLLOUT); }
+
+	// Removes the socket from the reactor. Optional before close(), unless the descriptor has been duplicated.
+	inline void forget(const int socket) noexcept { epoll_ctl(m_epoll, EPOLL_CTL_DEL, socket, nullptr); }
+
+public:
+	inline socket_reactor(const socket_reactor& other) = delete;
+	inline socket_reactor& operator=(const socket_reactor& rhs) = delete;
+
+private:
+	inline void poller_function();
+
+	static constexpr int m_events_per_wait = 64;
+
+	thread_pool&	m_pool;
+	int				m_epoll		= -1;
+	int				m_wakeup	= -1;	// eventfd registered with a null pointer, written once to stop the poller.
+	std::thread		m_poller;
+};
+
+
+inline void socket_reactor::readiness_awaiter::await_suspend(const std::coroutine_handle<> coroutine) {
+	m_coroutine = coroutine;
+
+	// One-shot registration: the socket is disarmed after one report, so exactly one resumption happens per wait.
+	// The poller may resume the coroutine before epoll_ctl returns, so the awaiter is not touched afterwards.
+	epoll_event event = {};
+	event.events = m_events | EPOLLONESHOT;
+	event.data.ptr = this;
+
+	const int epoll = m_reactor.m_epoll;
+	const int socket = m_socket;
+
+	if (epoll_ctl(epoll, EPOLL_CTL_MOD, socket, &event) == 0) {
+		return;
+	}
+
+	if (errno == ENOENT && epoll_ctl(epoll, EPOLL_CTL_ADD, socket, &event) == 0) {
+		return;
+	}
+
+	// Not registered, so nobody else resumes the coroutine: the exception is thrown from the co_await expression.
+	throw std::system_error(errno, std::system_category(), "socket_reactor: epoll_ctl failed");
+}
+
+inline socket_reactor::socket_reactor(thread_pool& pool) : m_pool(pool) {
+	m_epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (m_epoll < 0) {
+		throw std::system_error(errno, std::system_category(), "socket_reactor: epoll_create1 failed");
+	}
+
+	m_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr;
+
+	if (m_wakeup < 0 || epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &event) != 0) {
+		const int error = errno;
+
+		if (m_wakeup >= 0) {
+			close(m_wakeup);
+		}
+		close(m_epoll);
+
+		throw std::system_error(error, std::system_category(), "socket_reactor: eventfd failed");
+	}
+
+	m_poller = std::thread(&socket_reactor::poller_function, this);
+}
+
+inline socket_reactor::~socket_reactor() {
+	const std::uint64_t one = 1;
+	while (write(m_wakeup, &one, sizeof(one)) < 0 && errno == EINTR) {}
+
+	m_poller.join();
+
+	close(m_wakeup);
+	close(m_epoll);
+}
+
+inline void socket_reactor::poller_function() {
+	epoll_event events[m_events_per_wait];
+
+	while (true) {
+		const int ready = epoll_wait(m_epoll, events, m_events_per_wait, -1);
+
+		if (ready < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return;
+		}
+
+		for (int i = 0; i < ready; ++i) {
+			if (events[i].data.ptr == nullptr) {
+				return;
+			}
+
+			readiness_awaiter* const awaiter = static_cast<readiness_awaiter*>(events[i].data.ptr);
+			awaiter->m_events = events[i].events;
+
+			// Resumed on the pool, or right here if the pool no longer accepts tasks.
+			const std::coroutine_handle<> coroutine = awaiter->m_coroutine;
+			if (!m_pool.add_task([coroutine] { coroutine.resume(); })) {
+				coroutine.resume();
+			}
+		}
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+#include "unique_task.h"
+
+// Tasks posted to one strand run one at a time and in the order they were posted, on whatever workers of the pool are free;
+// different strands run in parallel. A strand is a lighter alternative to a mutex around per-client (or per-job) state, and to a
+// dedicated thread per client.
+// Posting takes no lock: the task is pushed onto a lock-free list and counted. Only the post that finds the strand idle adds a task
+// to the pool, which then runs the strand's tasks until there are none left (at most strand_batch_size of them per pool task,
+// so a busy strand doesn't keep a worker away from the rest of the pool).
+// strand is a handle: copies refer to the same strand, which lives as long as a copy or a pending task does.
+class strand {
+public:
+	inline explicit strand(thread_pool& pool) : m_state(std::make_shared<strand_state>(pool)) {}
+
+public:
+	// Runs task(parameters...) after every task posted to this strand before it, with the same binding rules as thread_pool::add_task.
+	// If the pool no longer accepts tasks, the strand's tasks run on the calling thread instead.
+	template <typename task_t, typename... arguments>
+	inline void post(task_t&& task, arguments&&... parameters);
+
+	// True inside a task of this strand.
+	inline bool running_in_this_thread() const { return tl_current_strand == m_state.get(); }
+
+private:
+	class strand_state;
+
+	inline static thread_local const strand_state* tl_current_strand = nullptr;
+
+	std::shared_ptr<strand_state> m_state;
+};
+
+// Tasks of one strand per key, e.g. per client socket or per matrix job. Keys are hashed onto a fixed set of strands, so two keys
+// may share a strand: their tasks then never overlap, but the order of each key's tasks is kept either way.
+template <typename key_t, typename hash_t = std::hash<key_t>>
+class keyed_strands {
+public:
+	// strands_amount = 0 - four strands per worker the pool has now, so that busy keys rarely collide.
+	inline explicit keyed_strands(thread_pool& pool, std::size_t strands_amount = 0);
+
+public:
+	template <typename task_t, typename... arguments>
+	inline void post(const key_t& key, task_t&& task, arguments&&... parameters) { strand_of(key).post(std::forward<task_t>(task), std::forward<arguments>(parameters)...); }
+
+	inline strand& strand_of(const key_t& key) { return m_strands[m_hash(key) % m_strands.size()]; }
+
+private:
+	std::vector<strand>	m_strands;
+	hash_t				m_hash;
+};
+
+// How many tasks of a strand one pool task runs before it hands the rest of them back to the pool.
+constexpr std::size_t strand_batch_size = 32;
+
+class strand::strand_state {
+public:
+	inline explicit strand_state(thread_pool& pool) : m_pool(pool) {}
+	inline ~strand_state();
+
+public:
+	template <typename task_t, typename... arguments>
+	inline void post(const std::shared_ptr<strand_state>& self, task_t&& task, arguments&&... parameters);
+
+private:
+	struct node {
+		template <typename task_t, typename... arguments>
+		inline node(task_t&& task_, arguments&&... parameters) : task(std::forward<task_t>(task_), std::forward<arguments>(parameters)...) {}
+
+		inline static void* operator new(const std::size_t size) { return task_memory_pool::allocate(size); }
+		inline static void operator delete(void* const block, const std::size_t size) { task_memory_pool::deallocate(block, size); }
+
+		unique_task	task;
+		node*		next = nullptr;
+	};
+
+	inline void schedule(const std::shared_ptr<strand_state>& self);
+	inline void drain(const std::shared_ptr<strand_state>& self);
+
+	thread_pool& m_pool;
+
+	// Posted tasks, newest first (pushed with a CAS). The draining thread takes the whole list at once and reverses it into m_batch.
+	alignas(cache_line_size) std::atomic<node*>			m_posted	= nullptr;
+	// Posted tasks that haven't finished. The post that raises it from zero schedules the strand; the task that drops it to zero ends the drain.
+	alignas(cache_line_size) std::atomic<std::size_t>	m_pending	= 0;
+
+	// Only touched by the thread draining the strand (at most one at a time).
+	alignas(cache_line_size) node*						m_batch		= nullptr;
+};
+
+
+template <typename task_t, typename... arguments>
+inline void strand::post(task_t&& task, arguments&&... parameters) {
+	m_state->post(m_state, std::forward<task_t>(task), std::forward<arguments>(parameters)...);
+}
+
+template <typename key_t, typename hash_t>
+inline keyed_strands<key_t, hash_t>::keyed_strands(thread_pool& pool, std::size_t strands_amount) {
+	if (strands_amount == 0) {
+		const std::size_t workers_amount = pool.worker_count();
+		strands_amount = 4 * (workers_amount > 0 ? workers_amount : 1);
+	}
+
+	m_strands.reserve(strands_amount);
+	for (std::size_t i = 0; i < strands_amount; ++i) {
+		m_strands.emplace_back(pool);
+	}
+}
+
+inline strand::strand_state::~strand_state() {
+	// Only reachable with tasks left if the pool deleted a drain task without running it.
+	for (node* list : { m_batch, m_posted.load(std::memory_order_acquire) }) {
+		while (list != nullptr) {
+			delete std::exchange(list, list->next);
+		}
+	}
+}
+
+template <typename task_t, typename... arguments>
+inline void strand::strand_state::post(const std::shared_ptr<strand_state>& self, task_t&& task, arguments&&... parameters) {
+	node* const posted = new node(std::forward<task_t>(task), std::forward<arguments>(parameters)...);
+
+	posted->next = m_posted.load(std::memory_order_relaxed);
+	while (!m_posted.compare_exchange_weak(posted->next, posted, std::memory_order_release, std::memory_order_relaxed)) {
+	}
+
+	// Counted after it is pushed, so whoever sees the count also finds the task.
+	if (m_pending.fetch_add(1, std::memory_order_acq_rel) == 0) {
+		schedule(self);
+	}
+}
+
+inline void strand::strand_state::schedule(const std::shared_ptr<strand_state>& self) {
+	if (!m_pool.add_task([self] { self->drain(self); })) {
+		drain(self);
+	}
+}
+
+inline void strand::strand_state::drain(const std::shared_ptr<strand_state>& self) {
+	const strand_state* const outer_strand = std::exchange(tl_current_strand, this);
+
+	for (std::size_t ran = 0; ; ) {
+		if (m_batch == nullptr) {
+			// Reverse the newest-first list into posting order. It can't be empty: m_pending counts tasks only after they are pushed.
+			node* list = m_posted.exchange(nullptr, std::memory_order_acquire);
+
+			while (list != nullptr) {
+				node* const next = list->next;
+				list->next = m_batch;
+				m_batch = list;
+				list = next;
+			}
+		}
+
+		node* const current = m_batch;
+		m_batch = current->next;
+
+		try {
+			current->task();
+		}
+		catch (...) {
+			// Give up the strand before the exception leaves (the posting thread gets it when drain runs inline, see schedule):
+			// the task counts as run, and the tasks after it get a drain of their own.
+			delete current;
+			tl_current_strand = outer_strand;
+
+			if (m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+				schedule(self);
+			}
+			throw;
+		}
+		delete current;
+
+		if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			break;
+		}
+
+		if (++ran == strand_batch_size) {
+			// Still owned by this drain (m_pending > 0), so nobody else schedules the strand meanwhile.
+			tl_current_strand = outer_strand;
+			schedule(self);
+			return;
+		}
+	}
+
+	tl_current_strand = outer_strand;
+}
\ No newline at end of file
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "unique_task.h"
+
+// Result slot shared by a submitted task and its task_future.
+// Completion is published through one atomic word: the task stores the result (or the exception) and flips the state to ready,
+// a waiter blocks on the same word with std::atomic::wait. The waiter announces itself first, so the task only pays for a notify
+// when somebody is actually waiting - there is no mutex and no condition variable per task.
+// The state is reference counted (one reference for the task, one for the future) and lives in a task_memory_pool block.
+template <typename result_t>
+class task_state {
+	using stored_t = std::conditional_t<std::is_void_v<result_t>, std::monostate,
+		std::conditional_t<std::is_reference_v<result_t>, std::reference_wrapper<std::remove_reference_t<result_t>>, result_t>>;
+
+public:
+	inline task_state() = default;
+
+	inline static void* operator new(const std::size_t size);
+	inline static void operator delete(void* const block, const std::size_t size);
+
+public:
+	template <typename... arguments>
+	inline void set_value(arguments&&... parameters);
+	inline void set_exception(std::exception_ptr exception);
+
+	inline bool is_ready() const { return m_state.load(std::memory_order_acquire) == ready; }
+	inline void wait() const;
+
+	// Must be called once, after wait().
+	inline result_t take();
+
+	inline void release();
+
+public:
+	inline task_state(const task_state& other) = delete;
+	inline task_state& operator=(const task_state& rhs) = delete;
+
+private:
+	inline void mark_ready();
+
+	static constexpr std::uint32_t pending				= 0;
+	static constexpr std::uint32_t pending_with_waiters	= 1;
+	static constexpr std::uint32_t ready				= 2;
+
+	mutable std::atomic<std::uint32_t>	m_state			= pending;
+	std::atomic<std::uint32_t>			m_references	= 2;
+
+	std::optional<stored_t>				m_value;
+	std::exception_ptr					m_exception;
+};
+
+// Handle to the result of a task submitted with thread_pool::submit. Move-only, like std::future.
+// get() waits for the task and returns its result or rethrows the exception it ended with. A task that is dropped without running
+// (rejected by the pool or deleted by terminate(true)) ends with std::future_error(std::future_errc::broken_promise).
+template <typename result_t>
+class task_future {
+public:
+	inline task_future() noexcept = default;
+	inline explicit task_future(task_state<result_t>* const state) noexcept : m_state(state) {}
+	inline ~task_future() { reset(); }
+
+	inline task_future(task_future&& other) noexcept : m_state(std::exchange(other.m_state, nullptr)) {}
+	inline task_future& operator=(task_future&& rhs) noexcept;
+
+public:
+	inline bool valid() const noexcept { return m_state != nullptr; }
+	inline bool is_ready() const { return m_state->is_ready(); }
+	inline void wait() const { m_state->wait(); }
+
+	// Waits for the task and returns its result. The future is invalid afterwards.
+	inline result_t get();
+
+public:
+	inline task_future(const task_future& other) = delete;
+	inline task_future& operator=(const task_future& rhs) = delete;
+
+private:
+	inline void reset() noexcept;
+
+	task_state<result_t>* m_state = nullptr;
+};
+
+// The callable that thread_pool::submit actually enqueues: runs the task and fulfils its task_state.
+template <typename result_t, typename callable_t>
+class promised_task {
+public:
+	inline promised_task(task_state<result_t>* const state, callable_t&& callable) : m_state(state), m_callable(std::move(callable)) {}
+	inline ~promised_task();
+
+	inline promised_task(promised_task&& other) noexcept(std::is_nothrow_move_constructible_v<callable_t>) : m_state(std::exchange(other.m_state, nullptr)), m_callable(std::move(other.m_callable)) {}
+
+	inline void operator()();
+
+public:
+	inline promised_task(const promised_task& other) = delete;
+	inline promised_task& operator=(const promised_task& rhs) = delete;
+	inline promised_task& operator=(promised_task&& rhs) = delete;
+
+private:
+	task_state<result_t>*	m_state;
+	callable_t				m_callable;
+};
+
+template <typename task_t, typename... arguments>
+using submitted_call = bound_call<std::decay_t<task_t>, std::decay_t<arguments>...>;
+
+template <typename task_t, typename... arguments>
+using submit_result = std::invoke_result_t<std::decay_t<task_t>, std::decay_t<arguments>...>;
+
+// Binds the task to its arguments and pairs it with the future of its result. Used by thread_pool::submit.
+template <typename task_t, typename... arguments>
+inline std::pair<task_future<submit_result<task_t, arguments...>>, promised_task<submit_result<task_t, arguments...>, submitted_call<task_t, arguments...>>>
+	package_task(task_t&& task, arguments&&... parameters);
+
+// Combines several futures into one that is ready when all of them are.
+// get() returns the results in the order of the futures (nothing for void tasks); if some tasks threw, it rethrows the exception
+// of the first of them, but only after all tasks have completed.
+template <typename result_t>
+class when_all_future {
+public:
+	inline when_all_future() = default;
+	inline explicit when_all_future(std::vector<task_future<result_t>> futures) : m_futures(std::move(futures)), m_valid(true) {}
+
+public:
+	inline bool valid() const noexcept { return m_valid; }
+	inline bool is_ready() const;
+	inline void wait() const;
+
+	inline auto get();
+
+private:
+	std::vector<task_future<result_t>>	m_futures;
+	bool								m_valid = false;
+};
+
+template <typename result_t>
+inline when_all_future<result_t> when_all(std::vector<task_future<result_t>> futures);
+
+template <typename iterator_t>
+inline auto when_all(iterator_t first, iterator_t last);
+
+
+template <typename result_t>
+inline void* task_state<result_t>::operator new(const std::size_t size) {
+	if constexpr (alignof(task_state) <= alignof(std::max_align_t)) {
+		return task_memory_pool::allocate(size);
+	}
+	else {
+		return ::operator new(size, std::align_val_t(alignof(task_state)));
+	}
+}
+
+template <typename result_t>
+inline void task_state<result_t>::operator delete(void* const block, const std::size_t size) {
+	if constexpr (alignof(task_state) <= alignof(std::max_align_t)) {
+		task_memory_pool::deallocate(block, size);
+	}
+	else {
+		::operator delete(block, std::align_val_t(alignof(task_state)));
+	}
+}
+
+template <typename result_t>
+template <typename... arguments>
+inline void task_state<result_t>::set_value(arguments&&... parameters) {
+	if constexpr (std::is_reference_v<result_t>) {
+		m_value.emplace(std::ref(parameters)...);
+	}
+	else {
+		m_value.emplace(std::forward<arguments>(parameters)...);
+	}
+
+	mark_ready();
+}
+
+template <typename result_t>
+inline void task_state<result_t>::set_exception(std::exception_ptr exception) {
+	m_exception = std::move(exception);
+	mark_ready();
+}
+
+template <typename result_t>
+inline void task_state<result_t>::mark_ready() {
+	if (m_state.exchange(ready, std::memory_order_acq_rel) == pending_with_waiters) {
+		m_state.notify_all();
+	}
+}
+
+template <typename result_t>
+inline void task_state<result_t>::wait() const {
+	std::uint32_t state = m_state.load(std::memory_order_acquire);
+
+	while (state != ready) {
+		if (state == pending && !m_state.compare_exchange_weak(state, pending_with_waiters, std::memory_order_acquire)) {
+			continue;
+		}
+
+		m_state.wait(pending_with_waiters, std::memory_order_acquire);
+		state = m_state.load(std::memory_order_acquire);
+	}
+}
+
+template <typename result_t>
+inline result_t task_state<result_t>::take() {
+	if (m_exception) {
+		std::rethrow_exception(m_exception);
+	}
+
+	if constexpr (std::is_void_v<result_t>) {
+		return;
+	}
+	else if constexpr (std::is_reference_v<result_t>) {
+		return static_cast<result_t>(m_value->get());
+	}
+	else {
+		return std::move(*m_value);
+	}
+}
+
+template <typename result_t>
+inline void task_state<result_t>::release() {
+	if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete this;
+	}
+}
+
+template <typename result_t>
+inline task_future<result_t>& task_future<result_t>::operator=(task_future&& rhs) noexcept {
+	if (this != &rhs) {
+		reset();
+		m_state = std::exchange(rhs.m_state, nullptr);
+	}
+
+	return *this;
+}
+
+template <typename result_t>
+inline result_t task_future<result_t>::get() {
+	struct release_on_exit {
+		inline ~release_on_exit() { state->release(); }
+		task_state<result_t>* state;
+	} guard{ std::exchange(m_state, nullptr) };
+
+	guard.state->wait();
+	return guard.state->take();
+}
+
+template <typename result_t>
+inline void task_future<result_t>::reset() noexcept {
+	if (m_state != nullptr) {
+		std::exchange(m_state, nullptr)->release();
+	}
+}
+
+template <typename result_t, typename callable_t>
+inline promised_task<result_t, callable_t>::~promised_task() {
+	if (m_state != nullptr) {
+		m_state->set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+		m_state->release();
+	}
+}
+
+template <typename result_t, typename callable_t>
+inline void promised_task<result_t, callable_t>::operator()() {
+	try {
+		if constexpr (std::is_void_v<result_t>) {
+			m_callable();
+			m_state->set_value();
+		}
+		else {
+			m_state->set_value(m_callable());
+		}
+	}
+	catch (...) {
+		m_state->set_exception(std::current_exception());
+	}
+
+	std::exchange(m_state, nullptr)->release();
+}
+
+template <typename task_t, typename... arguments>
+inline std::pair<task_future<submit_result<task_t, arguments...>>, promised_task<submit_result<task_t, arguments...>, submitted_call<task_t, arguments...>>>
+	package_task(task_t&& task, arguments&&... parameters) {
+	using result_t = submit_result<task_t, arguments...>;
+
+	submitted_call<task_t, arguments...> call{ std::forward<task_t>(task), std::forward_as_tuple(std::forward<arguments>(parameters)...) };
+	task_state<result_t>* const state = new task_state<result_t>();
+
+	return { std::piecewise_construct, std::forward_as_tuple(state), std::forward_as_tuple(state, std::move(call)) };
+}
+
+template <typename result_t>
+inline bool when_all_future<result_t>::is_ready() const {
+	for (const auto& future : m_futures) {
+		if (!future.is_ready()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+template <typename result_t>
+inline void when_all_future<result_t>::wait() const {
+	// Waiting for the futures one by one costs no more than waiting for the slowest one: the ones already completed are a single load.
+	for (const auto& future : m_futures) {
+		future.wait();
+	}
+}
+
+template <typename result_t>
+inline auto when_all_future<result_t>::get() {
+	wait();
+
+	std::vector<task_future<result_t>> futures = std::move(m_futures);
+	m_valid = false;
+
+	std::exception_ptr first_exception;
+
+	if constexpr (std::is_void_v<result_t>) {
+		for (auto& future : futures) {
+			try {
+				future.get();
+			}
+			catch (...) {
+				if (!first_exception) {
+					first_exception = std::current_exception();
+				}
+			}
+		}
+
+		if (first_exception) {
+			std::rethrow_exception(first_exception);
+		}
+	}
+	else {
+		using stored_t = std::conditional_t<std::is_reference_v<result_t>, std::reference_wrapper<std::remove_reference_t<result_t>>, result_t>;
+
+		std::vector<stored_t> results;
+		results.reserve(futures.size());
+
+		for (auto& future : futures) {
+			try {
+				if (!first_exception) {
+					results.emplace_back(future.get());
+				}
+				else {
+					future.get();
+				}
+			}
+			catch (...) {
+				if (!first_exception) {
+					first_exception = std::current_exception();
+				}
+			}
+		}
+
+		if (first_exception) {
+			std::rethrow_exception(first_exception);
+		}
+
+		return results;
+	}
+}
+
+template <typename result_t>
+inline when_all_future<result_t> when_all(std::vector<task_future<result_t>> futures) {
+	return when_all_future<result_t>(std::move(futures));
+}
+
+template <typename iterator_t>
+inline auto when_all(iterator_t first, iterator_t last) {
+	using future_t = typename std::iterator_traits<iterator_t>::value_type;
+
+	return when_all(std::vector<future_t>(std::make_move_iterator(first), std::make_move_iterator(last)));
+}
\ No newline at end of file
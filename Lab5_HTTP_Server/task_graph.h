@@ -0,0 +1,298 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "cancellation.h"
+#include "thread_pool.h"
+
+// A set of tasks with dependencies between them, run on a thread_pool. A node is released onto the pool as soon as all the nodes
+// it depends on are done, so independent parts of consecutive phases overlap instead of waiting for each other at a global barrier
+// (e.g. with per-chunk edges, block i of the second phase starts as soon as block i of the first phase is done).
+// Build the graph on one thread, then call run() once - the tasks are moved out when they run.
+class task_graph {
+public:
+	using node_id = std::size_t;
+
+	// Consecutive nodes created by add_nodes. Node i of the range is range[i].
+	struct node_range {
+		node_id		first	= 0;
+		std::size_t	amount	= 0;
+
+		inline node_id operator[](const std::size_t index) const { return first + index; }
+	};
+
+public:
+	inline task_graph() = default;
+
+	// Adds a node running task(parameters...), with the same binding rules as thread_pool::add_task.
+	template <typename task_t, typename... arguments>
+	inline node_id add_node(task_t&& task, arguments&&... parameters);
+
+	// Adds amount nodes, node i calls function(i). function is copied into every node.
+	template <typename function_t>
+	inline node_range add_nodes(const std::size_t amount, const function_t& function);
+
+	// to runs only after from is done.
+	inline void add_edge(const node_id from, const node_id to);
+	// Per-chunk edges: to[i] runs only after from[i] is done. The ranges must have the same amount of nodes.
+	inline void add_chunk_edges(const node_range& from, const node_range& to);
+	// Every node of to runs only after every node of from is done (through one empty node, not from.amount * to.amount edges).
+	inline void add_barrier(const node_range& from, const node_range& to);
+
+	inline std::size_t size() const { return m_nodes.size(); }
+
+	// Runs every node on the workers of pool and on the calling thread, and returns when all of them are done. Safe to call from
+	// inside a task of the same pool: the calling thread keeps running ready nodes while it waits.
+	// After a node has thrown, the nodes that haven't started yet are skipped; the first exception is rethrown here.
+	// The same happens (without an exception) once cancellation is cancelled - the running nodes may check it too.
+	// Throws std::invalid_argument if the edges form a cycle.
+	inline void run(thread_pool& pool, const cancellation_token& cancellation = {});
+
+public:
+	inline task_graph(const task_graph& other) = delete;
+	inline task_graph& operator=(const task_graph& rhs) = delete;
+
+private:
+	struct node {
+		unique_task				task;
+		std::vector<node_id>	successors;
+		std::size_t				dependencies = 0;
+	};
+
+	class run_state;
+
+	inline void check_for_cycles() const;
+
+	std::vector<node> m_nodes;
+};
+
+// Bookkeeping of one task_graph::run, shared by the calling thread and the helper tasks. Every ready node is put into m_ready_nodes
+// and announced to the pool with one helper task, which runs whatever node it finds there (if any). The state is reference counted
+// because a helper may start after run() has returned - such a helper finds no node and touches nothing but this state.
+class task_graph::run_state {
+public:
+	inline run_state(std::vector<node>& nodes, const cancellation_token& cancellation);
+
+public:
+	// Runs the node and then, on the same thread, one of the nodes it has released (the others go to the pool).
+	inline void run_node(const std::shared_ptr<run_state>& self, thread_pool& pool, node_id id);
+
+	// Runs ready nodes until none is left, waiting for the helpers in between. Called by the thread that called task_graph::run.
+	inline void run_until_done(const std::shared_ptr<run_state>& self, thread_pool& pool);
+
+	inline void release_node(const std::shared_ptr<run_state>& self, thread_pool& pool, const node_id id);
+
+private:
+	inline void signal();
+
+	std::vector<node>&							m_nodes;
+	std::unique_ptr<std::atomic<std::size_t>[]>	m_pending_dependencies;
+	concurrent_queue<node_id>					m_ready_nodes;
+
+	alignas(cache_line_size) std::atomic<std::size_t>	m_remaining_nodes;
+	alignas(cache_line_size) std::atomic<std::uint32_t>	m_signal			= 0;	// Changed whenever a node is released or the last one is done.
+
+	std::atomic<bool>	m_failed = false;
+	std::exception_ptr	m_exception;
+	cancellation_token	m_cancellation;
+};
+
+
+template <typename task_t, typename... arguments>
+inline task_graph::node_id task_graph::add_node(task_t&& task, arguments&&... parameters) {
+	m_nodes.push_back({ unique_task(std::forward<task_t>(task), std::forward<arguments>(parameters)...), {}, 0 });
+	return m_nodes.size() - 1;
+}
+
+template <typename function_t>
+inline task_graph::node_range task_graph::add_nodes(const std::size_t amount, const function_t& function) {
+	const node_range range{ m_nodes.size(), amount };
+
+	m_nodes.reserve(m_nodes.size() + amount);
+	for (std::size_t i = 0; i < amount; ++i) {
+		m_nodes.push_back({ unique_task(function, i), {}, 0 });
+	}
+
+	return range;
+}
+
+inline void task_graph::add_edge(const node_id from, const node_id to) {
+	if (from >= m_nodes.size() || to >= m_nodes.size()) {
+		throw std::invalid_argument("task_graph::add_edge: no such node.");
+	}
+
+	m_nodes[from].successors.push_back(to);
+	++m_nodes[to].dependencies;
+}
+
+inline void task_graph::add_chunk_edges(const node_range& from, const node_range& to) {
+	if (from.amount != to.amount) {
+		throw std::invalid_argument("task_graph::add_chunk_edges: the ranges have different amounts of nodes.");
+	}
+
+	for (std::size_t i = 0; i < from.amount; ++i) {
+		add_edge(from[i], to[i]);
+	}
+}
+
+inline void task_graph::add_barrier(const node_range& from, const node_range& to) {
+	const node_id barrier = m_nodes.size();
+	m_nodes.push_back({});
+
+	for (std::size_t i = 0; i < from.amount; ++i) {
+		add_edge(from[i], barrier);
+	}
+
+	for (std::size_t i = 0; i < to.amount; ++i) {
+		add_edge(barrier, to[i]);
+	}
+}
+
+inline void task_graph::check_for_cycles() const {
+	// Kahn's algorithm: if some nodes never get all their dependencies done, they are on (or behind) a cycle.
+	std::vector<std::size_t> pending(m_nodes.size());
+	std::vector<node_id> ready;
+
+	for (node_id id = 0; id < m_nodes.size(); ++id) {
+		pending[id] = m_nodes[id].dependencies;
+
+		if (pending[id] == 0) {
+			ready.push_back(id);
+		}
+	}
+
+	std::size_t visited = 0;
+	while (!ready.empty()) {
+		const node_id id = ready.back();
+		ready.pop_back();
+		++visited;
+
+		for (const node_id successor : m_nodes[id].successors) {
+			if (--pending[successor] == 0) {
+				ready.push_back(successor);
+			}
+		}
+	}
+
+	if (visited != m_nodes.size()) {
+		throw std::invalid_argument("task_graph::run: the edges form a cycle.");
+	}
+}
+
+inline void task_graph::run(thread_pool& pool, const cancellation_token& cancellation) {
+	if (m_nodes.empty()) {
+		return;
+	}
+
+	check_for_cycles();
+
+	auto state = std::make_shared<run_state>(m_nodes, cancellation);
+
+	for (node_id id = 0; id < m_nodes.size(); ++id) {
+		if (m_nodes[id].dependencies == 0) {
+			state->release_node(state, pool, id);
+		}
+	}
+
+	state->run_until_done(state, pool);
+}
+
+inline task_graph::run_state::run_state(std::vector<node>& nodes, const cancellation_token& cancellation)
+	: m_nodes(nodes), m_pending_dependencies(new std::atomic<std::size_t>[nodes.size()]), m_remaining_nodes(nodes.size()), m_cancellation(cancellation) {
+	for (std::size_t id = 0; id < nodes.size(); ++id) {
+		m_pending_dependencies[id].store(nodes[id].dependencies, std::memory_order_relaxed);
+	}
+}
+
+inline void task_graph::run_state::signal() {
+	m_signal.fetch_add(1, std::memory_order_release);
+	m_signal.notify_one();
+}
+
+inline void task_graph::run_state::release_node(const std::shared_ptr<run_state>& self, thread_pool& pool, const node_id id) {
+	m_ready_nodes.emplace(id);
+	signal();
+
+	pool.add_task([self, &pool] {
+		node_id ready_id = 0;
+
+		if (self->m_ready_nodes.pop(ready_id)) {
+			self->run_node(self, pool, ready_id);
+		}
+	});
+}
+
+inline void task_graph::run_state::run_node(const std::shared_ptr<run_state>& self, thread_pool& pool, node_id id) {
+	while (true) {
+		node& current = m_nodes[id];
+
+		if (current.task && !m_failed.load(std::memory_order_relaxed) && !m_cancellation.is_cancelled()) {
+			try {
+				current.task();
+			}
+			catch (...) {
+				if (!m_failed.exchange(true)) {
+					m_exception = std::current_exception();
+				}
+			}
+		}
+
+		current.task.reset();
+
+		// The first released successor continues on this thread, without a round trip through the queues.
+		bool continue_here = false;
+		node_id next_id = 0;
+
+		for (const node_id successor : current.successors) {
+			if (m_pending_dependencies[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				if (!continue_here) {
+					continue_here = true;
+					next_id = successor;
+				}
+				else {
+					release_node(self, pool, successor);
+				}
+			}
+		}
+
+		// The graph may be destroyed as soon as the last node is counted, so nothing but this state is touched afterwards.
+		if (m_remaining_nodes.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			signal();
+		}
+
+		if (!continue_here) {
+			return;
+		}
+
+		id = next_id;
+	}
+}
+
+inline void task_graph::run_state::run_until_done(const std::shared_ptr<run_state>& self, thread_pool& pool) {
+	while (true) {
+		const std::uint32_t seen_signal = m_signal.load(std::memory_order_acquire);
+
+		node_id id = 0;
+		if (m_ready_nodes.pop(id)) {
+			run_node(self, pool, id);
+			continue;
+		}
+
+		if (m_remaining_nodes.load(std::memory_order_acquire) == 0) {
+			break;
+		}
+
+		m_signal.wait(seen_signal, std::memory_order_acquire);
+	}
+
+	if (m_exception) {
+		std::rethrow_exception(m_exception);
+	}
+}
\ No newline at end of file
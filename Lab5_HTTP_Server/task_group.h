@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <utility>
+
+#include "atomic_wait.h"
+#include "cancellation.h"
+#include "concurrent_queue.h"
+#include "thread_pool.h"
+#include "unique_task.h"
+
+// Tasks of one job, run on a shared thread_pool and waited for (or cancelled) together, independently of whatever else the pool is running.
+// The tasks themselves wait in a queue of the group; the pool only gets one small ticket per task, which runs the oldest queued task
+// of the group. So cancel() deletes the queued tasks of the group at once - in O(group size), without searching the pool's queues -
+// and the tickets left in the pool find nothing to run. Running tasks see the cancellation through token().
+// The group counts its unfinished tasks, and wait() sleeps on that counter until it drops to zero - no polling, so the waiter
+// wakes up as soon as the last task of the group is done. The first exception thrown by a task is rethrown by wait().
+// The destructor waits for the tasks that are still pending, so they may safely capture locals of the scope owning the group.
+class task_group {
+public:
+	inline explicit task_group(thread_pool& pool) : m_pool(pool), m_state(std::make_shared<group_state>()) {}
+	inline ~task_group() { m_state->unfinished_tasks.wait(); }
+
+public:
+	// Adds task(parameters...) to the group, with the same binding rules as thread_pool::add_task. Returns false if the task was
+	// dropped: the group is cancelled, or the pool rejected the ticket (then one queued task of the group is dropped instead).
+	template <typename task_t, typename... arguments>
+	inline bool run(task_t&& task, arguments&&... parameters);
+
+	// Deletes the queued tasks of the group and cancels token(); tasks run after this are dropped until wait() returns.
+	// Running tasks finish on their own, as soon as they check the token.
+	inline void cancel();
+	inline bool is_cancelled() const { return m_state->cancellation.is_cancelled(); }
+
+	// Token for the tasks of the group to check while they run.
+	inline cancellation_token token() const { return m_state->cancellation.token(); }
+
+	inline bool is_idle() const { return m_state->unfinished_tasks.is_idle(); }
+
+	// Waits for every task run so far, then rethrows the first exception thrown by one of them (once).
+	// A cancelled group accepts tasks again afterwards. Must not be called from a task of the same group.
+	inline void wait();
+
+	// Same with a limit: returns false (without rethrowing anything) if some tasks were still pending at the limit.
+	inline bool wait_until(const std::chrono::steady_clock::time_point deadline);
+	template <typename rep_t, typename period_t>
+	inline bool wait_for(const std::chrono::duration<rep_t, period_t>& timeout);
+
+public:
+	inline task_group(const task_group& other) = delete;
+	inline task_group& operator=(const task_group& rhs) = delete;
+
+private:
+	// Shared with the tickets, because a ticket may still be in the pool (and touch the state) after the group is gone.
+	struct group_state {
+		inline void run_one();
+		inline void drop_one();
+		inline void drop_queued();
+
+		concurrent_queue<unique_task>	queued_tasks;
+		completion_counter				unfinished_tasks;
+		cancellation_source				cancellation;
+
+		std::atomic<bool>	failed		= false;
+		std::exception_ptr	exception;
+	};
+
+	class ticket;
+
+	inline void finish_waiting();
+
+	thread_pool&					m_pool;
+	std::shared_ptr<group_state>	m_state;
+};
+
+// What the pool runs for one task of the group. A ticket deleted without running (by terminate(true)) drops one task of the group.
+class task_group::ticket {
+public:
+	inline explicit ticket(std::shared_ptr<group_state> state) noexcept : m_state(std::move(state)) {}
+	inline ~ticket();
+
+	inline ticket(ticket&& other) noexcept = default;
+
+	inline void operator()() { std::exchange(m_state, nullptr)->run_one(); }
+
+public:
+	inline ticket(const ticket& other) = delete;
+	inline ticket& operator=(const ticket& rhs) = delete;
+	inline ticket& operator=(ticket&& rhs) = delete;
+
+private:
+	std::shared_ptr<group_state> m_state;
+};
+
+
+template <typename task_t, typename... arguments>
+inline bool task_group::run(task_t&& task, arguments&&... parameters) {
+	if (m_state->cancellation.is_cancelled()) {
+		return false;
+	}
+
+	// Counted before it is queued, so a fast ticket can't finish the task before it is counted.
+	m_state->unfinished_tasks.add();
+	m_state->queued_tasks.emplace(std::forward<task_t>(task), std::forward<arguments>(parameters)...);
+
+	return m_pool.add_task(ticket(m_state));
+}
+
+inline void task_group::cancel() {
+	m_state->cancellation.cancel();
+	m_state->drop_queued();
+}
+
+inline void task_group::wait() {
+	m_state->unfinished_tasks.wait();
+	finish_waiting();
+}
+
+inline bool task_group::wait_until(const std::chrono::steady_clock::time_point deadline) {
+	if (!m_state->unfinished_tasks.wait_until(deadline)) {
+		return false;
+	}
+
+	finish_waiting();
+	return true;
+}
+
+template <typename rep_t, typename period_t>
+inline bool task_group::wait_for(const std::chrono::duration<rep_t, period_t>& timeout) {
+	return wait_until(std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(timeout));
+}
+
+inline void task_group::finish_waiting() {
+	// All tasks are done, so nothing else touches the exception or depends on the cancellation; the group can be reused afterwards.
+	m_state->cancellation.reset();
+
+	if (m_state->failed.load(std::memory_order_acquire)) {
+		std::exception_ptr exception = std::move(m_state->exception);
+		m_state->exception = nullptr;
+		m_state->failed.store(false, std::memory_order_relaxed);
+
+		std::rethrow_exception(exception);
+	}
+}
+
+inline void task_group::group_state::run_one() {
+	unique_task task;
+
+	// Nothing to pop if cancel() has deleted the task this ticket was added for.
+	if (!queued_tasks.pop(task)) {
+		return;
+	}
+
+	if (!cancellation.is_cancelled()) {
+		try {
+			task();
+		}
+		catch (const operation_cancelled&) {
+		}
+		catch (...) {
+			bool expected = false;
+			if (failed.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+				exception = std::current_exception();
+			}
+		}
+	}
+
+	task.reset();
+	unfinished_tasks.finish();
+}
+
+inline void task_group::group_state::drop_one() {
+	unique_task task;
+
+	if (queued_tasks.pop(task)) {
+		task.reset();
+		unfinished_tasks.finish();
+	}
+}
+
+inline void task_group::group_state::drop_queued() {
+	unique_task task;
+	std::size_t dropped = 0;
+
+	while (queued_tasks.pop(task)) {
+		task.reset();
+		++dropped;
+	}
+
+	if (dropped > 0) {
+		unfinished_tasks.finish(dropped);
+	}
+}
+
+inline task_group::ticket::~ticket() {
+	if (m_state != nullptr) {
+		m_state->drop_one();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <fstream>
+#include <string>
+#endif
+
+// none       - the OS scheduler places (and migrates) the workers freely.
+// cores      - worker i is pinned to logical processor i (wrapping around), filling one NUMA node before the next.
+// numa_nodes - worker i is allowed to run on any processor of NUMA node i % nodes, so the workers are spread evenly over the nodes
+//              and memory first touched by a worker stays local to it.
+enum class thread_placement { none, cores, numa_nodes };
+
+// Logical processors and NUMA nodes available to the process, read once.
+// Every node has at least one processor; a machine (or OS) without NUMA information is one node holding all processors.
+class processor_topology {
+public:
+	inline static const processor_topology& get();
+
+public:
+	inline std::size_t processor_count() const { return m_processors.size(); }
+	inline std::size_t node_count() const { return m_nodes.size(); }
+	inline std::size_t node_of_processor(const std::size_t processor) const { return m_processors[processor].node; }
+
+	// Restrict the calling thread to one processor / to the processors of one node. Return false if the OS refused.
+	inline bool pin_current_thread_to_processor(const std::size_t processor) const;
+	inline bool pin_current_thread_to_node(const std::size_t node) const;
+
+	// The node of the processor the calling thread is running on right now.
+	inline std::size_t current_node() const;
+
+private:
+	inline processor_topology();
+
+	inline void add_processor(const std::size_t group, const std::size_t number, const std::size_t node);
+	inline bool pin_current_thread(const std::vector<std::size_t>& processors) const;
+
+	struct processor {
+		std::size_t group;		// Windows processor group (always 0 elsewhere).
+		std::size_t number;		// Number within the group (the CPU id elsewhere).
+		std::size_t node;		// Index into m_nodes.
+	};
+
+	std::vector<processor>					m_processors;
+	std::vector<std::vector<std::size_t>>	m_nodes;	// Indices into m_processors.
+};
+
+// Pins the calling worker thread according to placement and returns the NUMA node it will run on (0 for thread_placement::none).
+inline std::size_t place_worker_thread(const thread_placement placement, const std::size_t worker_index);
+
+
+inline const processor_topology& processor_topology::get() {
+	static const processor_topology topology;
+	return topology;
+}
+
+inline void processor_topology::add_processor(const std::size_t group, const std::size_t number, const std::size_t node) {
+	if (node >= m_nodes.size()) {
+		m_nodes.resize(node + 1);
+	}
+
+	m_nodes[node].push_back(m_processors.size());
+	m_processors.push_back({ group, number, node });
+}
+
+#ifdef _WIN32
+
+inline processor_topology::processor_topology() {
+	ULONG highest_node = 0;
+	GetNumaHighestNodeNumber(&highest_node);
+
+	// OS node numbers may have gaps (nodes without processors), so they are renumbered densely.
+	constexpr std::size_t unassigned = ~std::size_t(0);
+	std::vector<std::size_t> node_index(highest_node + 1, unassigned);
+	std::size_t nodes_found = 0;
+
+	const WORD groups_amount = GetActiveProcessorGroupCount();
+	for (WORD group = 0; group < groups_amount; ++group) {
+		const DWORD processors_amount = GetActiveProcessorCount(group);
+
+		for (DWORD number = 0; number < processors_amount; ++number) {
+			PROCESSOR_NUMBER processor_number = {};
+			processor_number.Group = group;
+			processor_number.Number = static_cast<BYTE>(number);
+
+			USHORT node = 0;
+			if (!GetNumaProcessorNodeEx(&processor_number, &node) || node > highest_node) {
+				node = 0;
+			}
+
+			if (node_index[node] == unassigned) {
+				node_index[node] = nodes_found++;
+			}
+
+			add_processor(group, number, node_index[node]);
+		}
+	}
+
+	m_nodes.resize(nodes_found > 0 ? nodes_found : 1);
+}
+
+inline bool processor_topology::pin_current_thread(const std::vector<std::size_t>& processors) const {
+	// A NUMA node never spans processor groups, so one GROUP_AFFINITY is enough.
+	GROUP_AFFINITY affinity = {};
+	affinity.Group = static_cast<WORD>(m_processors[processors.front()].group);
+
+	for (const std::size_t processor : processors) {
+		affinity.Mask |= KAFFINITY(1) << m_processors[processor].number;
+	}
+
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+}
+
+inline std::size_t processor_topology::current_node() const {
+	PROCESSOR_NUMBER current = {};
+	GetCurrentProcessorNumberEx(&current);
+
+	for (const processor& candidate : m_processors) {
+		if (candidate.group == current.Group && candidate.number == current.Number) {
+			return candidate.node;
+		}
+	}
+
+	return 0;
+}
+
+#else
+
+inline processor_topology::processor_topology() {
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+
+	// Node of every CPU from /sys/devices/system/node/nodeN/cpulist ("0-3,8-11"). Without it, everything is node 0.
+	std::vector<std::size_t> cpu_node(CPU_SETSIZE, 0);
+	std::size_t os_nodes = 0;
+
+	for (;; ++os_nodes) {
+		std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(os_nodes) + "/cpulist");
+		if (!cpulist) {
+			break;
+		}
+
+		std::string range;
+		while (std::getline(cpulist, range, ',')) {
+			const std::size_t dash = range.find('-');
+			const std::size_t first = std::stoul(range.substr(0, dash));
+			const std::size_t last = (dash == std::string::npos ? first : std::stoul(range.substr(dash + 1)));
+
+			for (std::size_t cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) {
+				cpu_node[cpu] = os_nodes;
+			}
+		}
+	}
+
+	// Renumber densely: nodes whose CPUs are all outside the process affinity mask are dropped.
+	constexpr std::size_t unassigned = ~std::size_t(0);
+	std::vector<std::size_t> node_index(os_nodes > 0 ? os_nodes : 1, unassigned);
+	std::size_t nodes_found = 0;
+
+	for (std::size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if (CPU_ISSET(cpu, &allowed)) {
+			if (node_index[cpu_node[cpu]] == unassigned) {
+				node_index[cpu_node[cpu]] = nodes_found++;
+			}
+
+			add_processor(0, cpu, node_index[cpu_node[cpu]]);
+		}
+	}
+
+	m_nodes.resize(nodes_found > 0 ? nodes_found : 1);
+}
+
+inline bool processor_topology::pin_current_thread(const std::vector<std::size_t>& processors) const {
+	cpu_set_t affinity;
+	CPU_ZERO(&affinity);
+
+	for (const std::size_t processor : processors) {
+		CPU_SET(m_processors[processor].number, &affinity);
+	}
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(affinity), &affinity) == 0;
+}
+
+inline std::size_t processor_topology::current_node() const {
+	const int cpu = sched_getcpu();
+
+	for (const processor& candidate : m_processors) {
+		if (cpu >= 0 && candidate.number == static_cast<std::size_t>(cpu)) {
+			return candidate.node;
+		}
+	}
+
+	return 0;
+}
+
+#endif
+
+inline bool processor_topology::pin_current_thread_to_processor(const std::size_t processor) const {
+	return processor < m_processors.size() && pin_current_thread({ processor });
+}
+
+inline bool processor_topology::pin_current_thread_to_node(const std::size_t node) const {
+	return node < m_nodes.size() && !m_nodes[node].empty() && pin_current_thread(m_nodes[node]);
+}
+
+inline std::size_t place_worker_thread(const thread_placement placement, const std::size_t worker_index) {
+	const processor_topology& topology = processor_topology::get();
+
+	if (placement == thread_placement::cores && topology.processor_count() > 0) {
+		const std::size_t processor = worker_index % topology.processor_count();
+		topology.pin_current_thread_to_processor(processor);
+		return topology.node_of_processor(processor);
+	}
+
+	if (placement == thread_placement::numa_nodes) {
+		const std::size_t node = worker_index % topology.node_count();
+		topology.pin_current_thread_to_node(node);
+		return node;
+	}
+
+	return 0;
+}
\ No newline at end of file
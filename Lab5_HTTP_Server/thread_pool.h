@@ -1,65 +1,480 @@
 #pragma once
 
+#include <array>
 #include <vector>
+#include <iterator>
 #include <functional>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
+#include <condition_variable>
 
+// The logging policy of thread_pool writes to std::clog.
+#include <iostream>
+#include <sstream>
+
+#include "atomic_wait.h"
 #include "concurrent_queue.h"
+#include "work_stealing_queue.h"
+#include "unique_task.h"
+#include "task_future.h"
+#include "pool_statistics.h"
+#include "thread_placement.h"
+#include "trace_recorder.h"
+
+// shared_queue  - all workers take tasks from one queue.
+// work_stealing - every worker owns a deque: tasks added from inside a worker go to its own deque, tasks added from the outside are
+//                 spread round-robin, and idle workers steal from the deques of others. Dequeues don't touch the pool-wide lock.
+enum class scheduling_mode { shared_queue, work_stealing };
+
+// How an idle worker waits for a task: it polls the queues spin_count times with a pause instruction in between, then yield_count times
+// yielding its time slice, and only then parks on the condition variable. A task added while a worker is still polling is picked up
+// without a kernel wakeup. Polling doesn't take the pool-wide lock - it watches a counter of added tasks and only looks into the queues
+// when the counter changes.
+struct wait_strategy {
+	std::size_t spin_count	= 0;
+	std::size_t yield_count	= 0;
+
+	// Park right away (the lowest CPU usage).
+	inline static constexpr wait_strategy blocking() { return { 0, 0 }; }
+	// Poll for a few microseconds before parking - for bursts of short tasks.
+	inline static constexpr wait_strategy hybrid() { return { 1024, 64 }; }
+};
+
+// Worker limits of an elastic pool (see thread_pool::initialize(const elastic_limits&)). The pool starts min_workers workers and adds
+// one more, up to max_workers, whenever more than queue_length_threshold tasks are queued or the queue hasn't been drained for
+// wait_threshold while no worker was idle (at most one new worker per wait_threshold). A worker that has found no task for idle_timeout
+// exits as long as more than min_workers remain - the newest workers exit first.
+struct elastic_limits {
+	std::size_t					min_workers				= 1;
+	std::size_t					max_workers				= 1;
+	std::size_t					queue_length_threshold	= 16;
+	std::chrono::milliseconds	wait_threshold			= std::chrono::milliseconds(5);
+	std::chrono::milliseconds	idle_timeout			= std::chrono::milliseconds(10000);
+};
+
+// How many times the idle workers of a pool have paused, yielded and parked in total.
+struct wait_counters {
+	std::size_t spins	= 0;
+	std::size_t yields	= 0;
+	std::size_t parks	= 0;
+};
+
+// Lanes of add_prioritized_task. Workers take high tasks before normal ones and normal tasks before low ones. Normal is the lane
+// of add_task, and while the other lanes are empty the pool runs exactly as if they didn't exist.
+enum class task_priority { high, normal, low };
+
+constexpr std::size_t task_priorities_amount = 3;
+
+// Starvation protection of the lanes: after this many tasks in a row taken while prioritized tasks were queued, a worker takes its
+// next task looking at the lanes from the lowest one up. So a flood of high (or normal) tasks delays a lower lane, but never
+// takes more than this share of a worker from it.
+constexpr std::size_t priority_starvation_limit = 8;
+
+// Queue depth of one lane, for monitoring. Counters are relaxed and may be a moment behind.
+struct lane_statistics {
+	std::size_t queued			= 0;	// Tasks waiting in the lane now.
+	std::size_t max_queued		= 0;	// The highest queued seen so far.
+	std::size_t added			= 0;	// Tasks added to the lane so far.
+	std::size_t starvation_runs	= 0;	// Tasks taken first by the starvation protection (while higher lanes may have been waiting).
+};
+
+// Queue policies. selectable_queue - the scheduling_mode passed to the constructor; fixed_queue<mode> - always mode (the constructor
+// argument is ignored), so the pool never checks the mode at run time.
+struct selectable_queue {};
 
-class thread_pool {
+template <scheduling_mode mode>
+struct fixed_queue {
+	static constexpr scheduling_mode value = mode;
+};
+
+// Wait policies. selectable_wait - the wait_strategy passed to the constructor; fixed_wait<spins, yields> - always { spins, yields }
+// (the constructor argument is ignored). With blocking_wait the workers never poll, so adding a task doesn't even bump the counter
+// polling workers watch.
+struct selectable_wait {};
+
+template <std::size_t spin_count, std::size_t yield_count>
+struct fixed_wait {
+	static constexpr wait_strategy value = { spin_count, yield_count };
+};
+
+using blocking_wait = fixed_wait<0, 0>;
+
+// Phase policies. continuous_phases - workers run tasks as soon as they are added.
+// timed_phases<interval_seconds> - the pool alternates between two phases every interval_seconds: in the accepting phase it takes
+// new tasks but the workers don't run them, in the executing phase the workers run the accepted tasks and new tasks are rejected.
+// It only switches to accepting once the running tasks have finished. A paused pool accepts tasks in either phase and runs none.
+// batched_release<max_batch_size, max_delay_microseconds> - new tasks are accepted all the time but staged, and handed to the workers
+// in batches: as soon as max_batch_size tasks are staged, or once the oldest staged task has waited max_delay_microseconds.
+// Fewer, larger wakeups for a bounded delay. Prioritized tasks are never staged.
+// The timer of both waits on a condition of the pool, so it releases a full batch at once and terminate() never waits for it.
+struct continuous_phases {};
+
+template <std::size_t interval_seconds>
+struct timed_phases {
+	static constexpr std::chrono::seconds interval = std::chrono::seconds(interval_seconds);
+};
+
+template <std::size_t max_batch_size_v, std::size_t max_delay_microseconds>
+struct batched_release {
+	static_assert(max_batch_size_v > 0, "A batch holds at least one task.");
+
+	static constexpr std::size_t				max_batch_size	= max_batch_size_v;
+	static constexpr std::chrono::microseconds	max_delay		= std::chrono::microseconds(max_delay_microseconds);
+};
+
+// Compile-time configuration of basic_thread_pool.
+// statistics - every worker records how long its tasks waited in the queue and ran (see snapshot()).
+// logging    - state changes and accepted / rejected tasks are written to std::clog.
+// tracing    - enqueues and task runs are recorded by trace_recorder, while it is started (a relaxed load per event otherwise).
+// A feature turned off here is removed with if constexpr: no run-time check, no clock reads, no timer thread.
+template <typename queue_t = selectable_queue, typename wait_t = selectable_wait, bool statistics_v = false, bool logging_v = false, typename phases_t = continuous_phases, bool tracing_v = false>
+struct pool_policies {
+	using queue		= queue_t;
+	using wait		= wait_t;
+	using phases	= phases_t;
+
+	static constexpr bool statistics	= statistics_v;
+	static constexpr bool logging		= logging_v;
+	static constexpr bool tracing		= tracing_v;
+};
+
+template <typename policies = pool_policies<>>
+class basic_thread_pool;
+
+// The lean pool - no statistics, no logging, no phases, no tracing. The Lab3 and Lab4 programs and everything built on the pool
+// (task_group, task_graph, strand, coroutines, parallel algorithms) use this one; the HTTP server adds only tracing to it.
+using thread_pool = basic_thread_pool<>;
+
+// The pool of Lab2: accepting and executing phases switched by a timer, logging with debug, statistics (by default with debug).
+template <bool debug = false, bool statistics = debug, std::size_t interval_seconds = 30>
+using phased_thread_pool = basic_thread_pool<pool_policies<selectable_queue, blocking_wait, statistics, debug, timed_phases<interval_seconds>>>;
+
+// Awaitable returned by thread_pool::schedule(): suspends the awaiting coroutine and resumes it on a worker of the pool.
+// If the pool doesn't accept tasks, the coroutine simply continues on the current thread.
+template <typename pool_t>
+class schedule_awaiter {
+public:
+	inline explicit schedule_awaiter(pool_t& pool) noexcept : m_pool(pool) {}
+
+	inline bool await_ready() const noexcept { return false; }
+	inline bool await_suspend(const std::coroutine_handle<> coroutine);
+	inline void await_resume() const noexcept {}
+
+private:
+	pool_t& m_pool;
+};
+
+template <typename policies>
+class basic_thread_pool {
 public:
-	inline thread_pool() = default;
-	inline ~thread_pool() { terminate(); }
+	inline explicit basic_thread_pool(const scheduling_mode mode = scheduling_mode::shared_queue, const wait_strategy strategy = wait_strategy::blocking(), const thread_placement placement = thread_placement::none)
+		: m_mode(mode), m_wait_strategy(strategy), m_placement(placement) {}
+	inline ~basic_thread_pool() { terminate(); }
 
 public:
 	inline void initialize(const std::size_t worker_count);
+	// Starts an elastic pool whose worker count follows the load between limits.min_workers and limits.max_workers.
+	inline void initialize(const elastic_limits& limits);
 	inline void terminate(const bool immediately = false);
 
 	inline void set_paused(const bool paused);
 	inline bool is_paused() const;
 
+	// Whether add_task would accept a task now: the pool is working and, with timed_phases, in its accepting phase (or paused).
+	inline bool accepting()			const;
+	inline bool accepting_unsafe()	const;
 	inline bool working()			const;
 	inline bool working_unsafe()	const;
 
+	inline std::size_t worker_count() const;
+	inline wait_counters waiting_statistics() const;
+
+	// With thread_placement::numa_nodes - the amount of NUMA nodes that always have a worker of this pool, otherwise 1.
+	// parallel_for and parallel_reduce split their ranges into this many contiguous parts and let every node process its own part.
+	inline std::size_t placement_groups() const;
+	// The node (below placement_groups()) of the calling thread: the node a worker of this pool is pinned to, or the node the calling
+	// thread happens to run on.
+	inline std::size_t placement_group_of_current_thread() const;
+
+	// Returns false if the pool doesn't accept tasks now (it is not working, or with timed_phases it is executing) - the task is dropped then.
+	template <typename task_t, typename... arguments>
+	inline bool add_task(task_t&& task, arguments&&... parameters);
+
+	// Block until every accepted task (including the tasks added by running tasks) has finished, or until terminate() has
+	// completed. Must not be called from a task of this pool. The timed versions return false if tasks were still pending at the limit.
+	inline void wait_idle() const { m_unfinished_tasks.wait(); }
+	inline bool wait_idle_until(const std::chrono::steady_clock::time_point deadline) const { return m_unfinished_tasks.wait_until(deadline); }
+	template <typename rep_t, typename period_t>
+	inline bool wait_idle_for(const std::chrono::duration<rep_t, period_t>& timeout) const;
+
+	// Same as add_task, but the task goes to the lane of the given priority (task_priority::normal is plain add_task).
+	// For mixed interactive and batch work: interactive tasks added as high overtake a backlog of batch tasks.
 	template <typename task_t, typename... arguments>
-	inline void add_task(task_t&& task, arguments&&... parameters);
+	inline bool add_prioritized_task(const task_priority priority, task_t&& task, arguments&&... parameters);
+
+	// Queue depths of the lanes, indexed by task_priority.
+	inline std::array<lane_statistics, task_priorities_amount> lane_metrics() const;
+
+	// Statistics of the tasks completed since initialize(), can be taken while the pool is working. Empty unless policies::statistics.
+	inline thread_pool_snapshot snapshot() const;
+
+	// co_await pool.schedule() continues the calling coroutine on a worker of this pool.
+	inline schedule_awaiter<basic_thread_pool> schedule() noexcept { return schedule_awaiter<basic_thread_pool>(*this); }
+
+	// Same as add_task, but returns a task_future that receives the result (or the exception) of the task.
+	template <typename task_t, typename... arguments>
+	inline task_future<submit_result<task_t, arguments...>> submit(task_t&& task, arguments&&... parameters);
+
+	// Adds every callable of [first, last) (copied, or moved with move iterators) under one lock and wakes at most as many workers
+	// as there are new tasks. The batch is accepted or rejected as a whole; returns the amount of added tasks.
+	template <typename iterator_t>
+	inline std::size_t add_tasks(iterator_t first, iterator_t last);
+
+	// Adds amount tasks calling function(i) for every i in [0, amount), the same way as add_tasks.
+	// function is copied into every task, so it should be cheap to copy (e.g. a lambda capturing by reference).
+	template <typename function_t>
+	inline std::size_t add_task_batch(const std::size_t amount, const function_t& function);
 
 public:
-	inline thread_pool(const thread_pool& other) = delete;
-	inline thread_pool(thread_pool&& other) = delete;
-	inline thread_pool& operator=(const thread_pool& rhs) = delete;
-	inline thread_pool& operator=(thread_pool&& rhs) = delete;
+	inline basic_thread_pool(const basic_thread_pool& other) = delete;
+	inline basic_thread_pool(basic_thread_pool&& other) = delete;
+	inline basic_thread_pool& operator=(const basic_thread_pool& rhs) = delete;
+	inline basic_thread_pool& operator=(basic_thread_pool&& rhs) = delete;
 
 private:
-	inline void routine();
+	static constexpr bool collects_statistics	= policies::statistics;
+	static constexpr bool logs					= policies::logging;
+	static constexpr bool traces				= policies::tracing;
+	static constexpr bool phased				= requires { policies::phases::interval; };
+	static constexpr bool batched				= requires { policies::phases::max_batch_size; };
+	static constexpr bool fixed_mode			= requires { policies::queue::value; };
+	static constexpr bool fixed_wait_strategy	= requires { policies::wait::value; };
+
+	// Whether idle workers may poll before parking (only a fixed strategy without spins and yields rules it out).
+	static constexpr bool polls = [] {
+		if constexpr (fixed_wait_strategy) {
+			return policies::wait::value.spin_count + policies::wait::value.yield_count > 0;
+		}
+		else {
+			return true;
+		}
+	}();
+
+	using queued_task = std::conditional_t<collects_statistics, timed_task, unique_task>;
+
+	inline bool uses_work_stealing() const;
+	inline wait_strategy current_wait_strategy() const;
+
+	// Whether workers may take tasks now: the pool is not paused and, with timed_phases, it is executing.
+	inline bool may_run_tasks() const;
+	inline bool accepts_tasks_unsafe() const;
+
+	inline void routine(const std::size_t worker_index);
+	inline void run_task(const std::size_t worker_index, queued_task& task);
+	inline void leave_active_task();
+	inline bool acquire_task(const std::size_t worker_index, queued_task& task);
+	inline bool acquire_normal_task(const std::size_t worker_index, queued_task& task);
+	inline bool acquire_prioritized_task(const std::size_t worker_index, queued_task& task);
+	inline bool acquire_lane_task(const task_priority priority, queued_task& task);
+	inline bool poll_for_task(const std::size_t worker_index, queued_task& task);
+	inline void notify_pollers();
+	inline std::size_t queued_tasks_amount() const;
+	inline std::size_t normal_queued_tasks_amount() const;
+
+	inline void scaler_function();
+	inline void add_worker_unsafe();
+	inline bool may_retire_unsafe(const std::size_t worker_index) const;
+
+	inline void timer_function();
+
+	inline void release_function();
+	inline bool stage_unsafe(const std::size_t amount);
+	inline void release_staged_unsafe();
+
+	template <typename factory_t>
+	inline std::size_t add_task_batch_from(const std::size_t amount, factory_t& make_task);
+	template <typename factory_t>
+	inline void enqueue_batch_unsafe(const std::size_t amount, factory_t& make_task);
 
 	mutable read_write_lock					m_rw_lock;
 	mutable std::condition_variable_any		m_task_waiter;
-	std::vector<std::thread>				m_workers;
+	std::vector<std::thread>				m_workers;			// One slot per possible worker; slots from m_live_workers on hold exited (or no) threads.
+	std::atomic<std::size_t>				m_live_workers		= 0;
+
+	concurrent_queue<queued_task>			m_tasks;
+	completion_counter						m_unfinished_tasks;	// Accepted tasks that haven't finished yet (queued or running).
+
+	bool				m_initialized = false;
+	std::atomic<bool>	m_terminated = false;
+	std::atomic<bool>	m_paused = false;
+
+private:
+	const scheduling_mode									m_mode;
+	std::vector<work_stealing_queue<queued_task>>			m_local_tasks;
+	std::atomic<std::size_t>								m_next_local_queue	= 0;
+	std::size_t												m_sleeping_workers	= 0;
+
+	// Identifies the worker thread (if any) the current thread is, so tasks added from inside a worker go to its own deque.
+	inline static thread_local const basic_thread_pool*	tl_current_pool		= nullptr;
+	inline static thread_local std::size_t				tl_worker_index		= 0;
+	inline static thread_local std::size_t				tl_worker_node		= 0;
+	inline static thread_local std::size_t				tl_priority_streak	= 0;	// Tasks in a row this worker took while the lanes were in use.
+
+private:
+	const wait_strategy m_wait_strategy;
+
+	// Incremented after every added task (or batch), so polling workers only look into the queues when something has been added.
+	alignas(cache_line_size) std::atomic<std::size_t>	m_added_tasks_epoch	= 0;
+
+	alignas(cache_line_size) std::atomic<std::size_t>	m_spins				= 0;
+	std::atomic<std::size_t>							m_yields			= 0;
+	std::atomic<std::size_t>							m_parks				= 0;
+
+private:
+	const thread_placement					m_placement;
+
+private:
+	// The high and low lanes (the normal lane is m_tasks / m_local_tasks). Every lane has its own cache lines.
+	struct alignas(cache_line_size) priority_lane {
+		concurrent_queue<queued_task>	tasks;
+		std::atomic<std::size_t>		queued			= 0;
+		std::atomic<std::size_t>		max_queued		= 0;
+		std::atomic<std::size_t>		added			= 0;
+		std::atomic<std::size_t>		starvation_runs	= 0;
+	};
+
+	inline priority_lane& lane(const task_priority priority) { return m_lanes[priority == task_priority::high ? 0 : 1]; }
+	inline const priority_lane& lane(const task_priority priority) const { return m_lanes[priority == task_priority::high ? 0 : 1]; }
+
+	std::array<priority_lane, 2>						m_lanes;
+	alignas(cache_line_size) std::atomic<std::size_t>	m_prioritized_tasks		= 0;	// Tasks in both lanes; the only thing a worker reads while they are unused.
+	std::atomic<std::size_t>							m_normal_starvation_runs	= 0;
+
+private:
+	elastic_limits							m_limits;
+	bool									m_elastic			= false;
+	std::thread								m_scaler_thread;
+	mutable std::condition_variable_any		m_scaler_waiter;
+	bool									m_scaler_parked		= false;
+
+private:
+	struct no_state {};
+
+	// IMPORTANT NOTE: accepting_new_tasks represents current readiness state of a thread pool to accept new tasks from the user code and to add them to the internal task queue.
+	// =======================================================================================================================================================================
+	// When accepting_new_tasks is true, thread pool accepts new tasks from the user code,
+	// BUT the thread pool itself does NOT start executing tasks from the internal task queue (worker threads stop).
+	// -----------------------------------------------------------------------------------------------------------------------------------------------------------------------
+	// When accepting_new_tasks is false, thread pool rejects new tasks from the user code,
+	// BUT the thread pool itself IS working internally by STARTING executing tasks from the internal task queue (worker threads execute tasks).
+	struct phase_state {
+		std::atomic<bool>			accepting_new_tasks	= false;
+		std::atomic<std::size_t>	active_tasks		= 0;
+
+		std::thread					timer_thread;
+		std::condition_variable_any	timer_waiter;
+	};
+
+	// Tasks waiting for the next batch. Added under the read lock and released under the write lock, so the release function
+	// sees every staged task it has counted.
+	struct batch_state {
+		concurrent_queue<queued_task>							staged;
+		std::atomic<std::size_t>								staged_amount		= 0;
+		std::atomic<std::chrono::steady_clock::time_point>		first_staged_at		= std::chrono::steady_clock::time_point();
+
+		std::thread					timer_thread;
+		std::condition_variable_any	timer_waiter;
+	};
 
-	concurrent_queue<std::function<void()>>	m_tasks;
+	// One entry per possible worker, written by that worker only.
+	struct statistics_state {
+		std::unique_ptr<worker_statistics[]>	workers;
+		std::size_t								workers_amount	= 0;
+	};
 
-	bool m_initialized = false;
-	bool m_terminated = false;
-	bool m_paused = false;
+	std::conditional_t<phased, phase_state, std::conditional_t<batched, batch_state, no_state>>	m_phases;
+	std::conditional_t<collects_statistics, statistics_state, no_state>								m_statistics;
 };
 
 
-inline void thread_pool::initialize(const std::size_t worker_count) {
+template <typename policies>
+inline void basic_thread_pool<policies>::initialize(const std::size_t worker_count) {
+	elastic_limits limits;
+	limits.min_workers = worker_count;
+	limits.max_workers = worker_count;
+
+	initialize(limits);
+}
+
+template <typename policies>
+inline void basic_thread_pool<policies>::initialize(const elastic_limits& limits) {
 	write_lock w_lock(m_rw_lock);
 
-	if (m_initialized || m_terminated) {
+	if (m_initialized || m_terminated || limits.min_workers == 0 || limits.max_workers < limits.min_workers) {
+		if constexpr (logs) {
+			if (!m_initialized && !m_terminated) {
+				std::ostringstream ss; ss << "TP " << this << ": FAILED TO INITIALIZE: incorrect amount of worker threads.\n";
+				std::clog << ss.str();
+			}
+		}
 		return;
 	}
 
-	m_workers.reserve(worker_count);
-	for (size_t id = 0; id < worker_count; ++id) {
-		m_workers.emplace_back(&thread_pool::routine, this);
+	if constexpr (logs) {
+		std::ostringstream ss; ss << "TP " << this << ": INITIALIZING" << (uses_work_stealing() ? " (work-stealing mode)" : "") << ".\n";
+		std::clog << ss.str();
+	}
+
+	m_limits = limits;
+	m_elastic = limits.max_workers > limits.min_workers;
+
+	// Deques and thread slots are allocated for max_workers up front, so adding a worker never moves them under the lock-free pollers.
+	if (uses_work_stealing()) {
+		m_local_tasks = std::vector<work_stealing_queue<queued_task>>(limits.max_workers);
+	}
+
+	if constexpr (collects_statistics) {
+		m_statistics.workers = std::make_unique<worker_statistics[]>(limits.max_workers);
+		m_statistics.workers_amount = limits.max_workers;
+	}
+
+	// Workers look for tasks without the lock, so they must see the accepting phase from the start
+	// (otherwise they count themselves as active and make add_task reject tasks until they go to sleep).
+	if constexpr (phased) {
+		m_phases.accepting_new_tasks = true;
+	}
+
+	m_workers.resize(limits.max_workers);
+	for (size_t id = 0; id < limits.min_workers; ++id) {
+		add_worker_unsafe();
 	}
 
-	m_initialized = !m_workers.empty();
+	if (m_elastic) {
+		m_scaler_thread = std::thread(&basic_thread_pool::scaler_function, this);
+	}
+
+	if constexpr (phased) {
+		m_phases.timer_thread = std::thread(&basic_thread_pool::timer_function, this);
+	}
+	else if constexpr (batched) {
+		m_phases.timer_thread = std::thread(&basic_thread_pool::release_function, this);
+	}
+
+	m_initialized = true;
+
+	if constexpr (logs) {
+		std::ostringstream ss; ss << "TP " << this << ": INITIALIZED." << (accepts_tasks_unsafe() ? " ACCEPTING" : " REJECTING") << " new tasks.\n";
+		std::clog << ss.str();
+	}
 }
 
-inline void thread_pool::terminate(const bool immediately) {
+template <typename policies>
+inline void basic_thread_pool<policies>::terminate(const bool immediately) {
 	{
 		write_lock w_lock(m_rw_lock);
 
@@ -67,8 +482,37 @@ inline void thread_pool::terminate(const bool immediately) {
 			m_terminated = true;
 			m_paused = false;
 
+			if constexpr (phased) {
+				m_phases.accepting_new_tasks = false;
+			}
+			else if constexpr (batched) {
+				// The rest is run (or deleted right below) like any queued task, without waiting for the batch to fill up.
+				release_staged_unsafe();
+			}
+
 			if (immediately) {
 				m_tasks.clear();
+
+				for (auto& local_tasks : m_local_tasks) {
+					local_tasks.clear();
+				}
+
+				// Popped one by one, so the counters stay consistent with workers that are taking a task right now.
+				queued_task dropped;
+				while (acquire_lane_task(task_priority::high, dropped) || acquire_lane_task(task_priority::low, dropped)) {
+					dropped = queued_task();
+				}
+			}
+
+			if constexpr (logs) {
+				if (immediately) {
+					std::ostringstream ss; ss << "TP " << this << ": TERMINATING immediately - ending current active tasks and deleting existing tasks from the internal queue. Rejecting any new tasks.\n";
+					std::clog << ss.str();
+				}
+				else {
+					std::ostringstream ss; ss << "TP " << this << ": TERMINATING - forcing worker threads to start executing existing tasks. Rejecting any new tasks.\n";
+					std::clog << ss.str();
+				}
 			}
 		}
 		else {
@@ -77,87 +521,925 @@ inline void thread_pool::terminate(const bool immediately) {
 	}
 
 	m_task_waiter.notify_all();
+	m_scaler_waiter.notify_all();
+
+	if constexpr (phased || batched) {
+		m_phases.timer_waiter.notify_all();
+		m_phases.timer_thread.join();
+	}
+
+	// The scaler is the only one adding workers (under the lock, and never after m_terminated is set), so once it has stopped
+	// m_workers doesn't change any more. Slots of retired workers hold threads that have already left routine.
+	if (m_scaler_thread.joinable()) {
+		m_scaler_thread.join();
+	}
 
 	for (std::thread& worker : m_workers) {
-		worker.join();
+		if (worker.joinable()) {
+			worker.join();
+		}
 	}
 
+	// Tasks deleted by terminate(true) never finish, so the waiters are released here.
+	m_unfinished_tasks.reset();
+
 	write_lock w_lock(m_rw_lock);
 
 	m_workers.clear();
+	m_local_tasks.clear();
+	m_live_workers = 0;
+	m_elastic = false;
 	m_terminated = false;
 	m_initialized = false;
 	m_paused = false;
+
+	if constexpr (logs) {
+		std::ostringstream ss; ss << "TP " << this << ": TERMINATED.\n";
+
+		if constexpr (collects_statistics) {
+			const thread_pool_snapshot statistics_snapshot = summarize_statistics(m_statistics.workers.get(), m_statistics.workers_amount);
+
+			auto print_latency = [&ss](const char* const name, const latency_summary& latency) {
+				ss << name << "mean " << latency.mean_ns / 1000 << " us, p50 " << latency.p50_ns / 1000 << " us, p90 " << latency.p90_ns / 1000
+					<< " us, p99 " << latency.p99_ns / 1000 << " us, p99.9 " << latency.p999_ns / 1000 << " us, max " << latency.max_ns / 1000 << " us.\n";
+			};
+
+			if (statistics_snapshot.completed_tasks > 0) {
+				ss << "TP " << this << ": STATISTICS (" << statistics_snapshot.completed_tasks << " tasks):\n";
+				print_latency("\tWAITING TIME:    ", statistics_snapshot.wait);
+				print_latency("\tCOMPLETING TIME: ", statistics_snapshot.run);
+				ss << "\tAVERAGE QUEUE LENGTH:    " << statistics_snapshot.average_queue_length << ".\n";
+			}
+		}
+
+		std::clog << ss.str();
+	}
 }
 
-inline void thread_pool::routine() {
+template <typename policies>
+inline void basic_thread_pool<policies>::routine(const std::size_t worker_index) {
+	tl_current_pool = this;
+	tl_worker_index = worker_index;
+	tl_worker_node = (m_placement != thread_placement::none ? place_worker_thread(m_placement, worker_index) : 0);
+
 	while (true) {
 		bool task_accquiered = false;
-		std::function<void()> task;
+		queued_task task;
 
-		std::chrono::milliseconds waiting_time;
+		// A worker first looks for a task (in work-stealing mode in its own deque and the deques of others) and keeps polling
+		// as long as its wait_strategy allows, without taking the pool-wide lock. The lock is only taken to park.
+		if (may_run_tasks()) {
+			if constexpr (phased) {
+				// The task is counted as active before the phase is checked again, so the timer can't switch to accepting new tasks
+				// (it waits for active_tasks == 0) while this worker is about to start one.
+				++m_phases.active_tasks;
 
-		{
+				if (may_run_tasks()) {
+					task_accquiered = poll_for_task(worker_index, task);
+				}
+
+				if (!task_accquiered) {
+					leave_active_task();
+				}
+			}
+			else {
+				task_accquiered = poll_for_task(worker_index, task);
+			}
+		}
+
+		if (!task_accquiered) {
 			write_lock w_lock(m_rw_lock);
 
-			auto wait_condition = [this, &task_accquiered, &task] {
-				if (m_paused) {
+			auto wait_condition = [this, worker_index, &task_accquiered, &task] {
+				if (!may_run_tasks()) {
 					return false;
 				}
 
-				task_accquiered = m_tasks.pop(task);
+				task_accquiered = acquire_task(worker_index, task);
 				return m_terminated || task_accquiered;
 			};
 
-			m_task_waiter.wait(w_lock, wait_condition);
+			auto idle_deadline = std::chrono::steady_clock::now() + m_limits.idle_timeout;
+			bool idle_timed_out = false;
+
+			++m_sleeping_workers;
+			while (!wait_condition()) {
+				if (idle_timed_out) {
+					if (may_retire_unsafe(worker_index)) {
+						--m_sleeping_workers;
+						--m_live_workers;
+						return;
+					}
+
+					idle_deadline = std::chrono::steady_clock::now() + m_limits.idle_timeout;
+				}
+
+				m_parks.fetch_add(1, std::memory_order_relaxed);
+
+				if (m_elastic) {
+					idle_timed_out = m_task_waiter.wait_until(w_lock, idle_deadline) == std::cv_status::timeout;
+				}
+				else {
+					m_task_waiter.wait(w_lock);
+				}
+			}
+			--m_sleeping_workers;
 
 			if (m_terminated && !task_accquiered) {
 				return;
 			}
+
+			if constexpr (phased) {
+				++m_phases.active_tasks;
+			}
 		}
 
+		run_task(worker_index, task);
+
+		if constexpr (phased) {
+			leave_active_task();
+		}
+	}
+}
+
+template <typename policies>
+inline void basic_thread_pool<policies>::run_task(const std::size_t worker_index, queued_task& task) {
+	if constexpr (traces) {
+		trace_recorder::get().record("task", "thread_pool", trace_phase::begin, worker_index);
+	}
+
+	if constexpr (collects_statistics) {
+		const std::size_t queue_length = queued_tasks_amount();
+
+		const auto started = std::chrono::steady_clock::now();
 		task();
+		const auto finished = std::chrono::steady_clock::now();
+
+		m_statistics.workers[worker_index].record_task(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(started - task.enqueued_at).count(),
+			std::chrono::duration_cast<std::chrono::nanoseconds>(finished - started).count(),
+			queue_length);
+	}
+	else {
+		task();
+	}
+
+	if constexpr (traces) {
+		trace_recorder::get().record("task", "thread_pool", trace_phase::end);
+	}
+
+	// Destroyed before it is counted, so whatever it has captured is gone by the time wait_idle returns.
+	task = queued_task();
+	m_unfinished_tasks.finish();
+}
+
+template <typename policies>
+inline void basic_thread_pool<policies>::leave_active_task() {
+	// Only the end of the last active task can let the timer switch phases. Taking the lock (shared is enough) before notifying
+	// guarantees the timer either already waits or will see the counter at zero when it checks its condition.
+	if (m_phases.active_tasks.fetch_sub(1) == 1) {
+		{
+			read_lock r_lock(m_rw_lock);
+		}
+
+		m_phases.timer_waiter.notify_one();
+	}
+}
+
+template <typename policies>
+inline bool basic_thread_pool<policies>::poll_for_task(const std::size_t worker_index, queued_task& task) {
+	if constexpr (!polls) {
+		return acquire_task(worker_index, task);
+	}
+	else {
+		std::size_t seen_epoch = m_added_tasks_epoch.load(std::memory_order_acquire);
+
+		if (acquire_task(worker_index, task)) {
+			return true;
+		}
+
+		const wait_strategy strategy = current_wait_strategy();
+		const std::size_t polls_amount = strategy.spin_count + strategy.yield_count;
+		std::size_t poll = 0;
+		bool task_accquiered = false;
+
+		for (; poll < polls_amount && !task_accquiered && !m_terminated && may_run_tasks(); ++poll) {
+			if (poll < strategy.spin_count) {
+				cpu_relax();
+			}
+			else {
+				std::this_thread::yield();
+			}
+
+			const std::size_t epoch = m_added_tasks_epoch.load(std::memory_order_acquire);
+			if (epoch != seen_epoch) {
+				seen_epoch = epoch;
+				task_accquiered = acquire_task(worker_index, task);
+			}
+		}
+
+		// Counted once per poll_for_task call, not per iteration, so idle workers don't fight over the counters' cache line.
+		if (poll > 0) {
+			const std::size_t spins = (poll < strategy.spin_count ? poll : strategy.spin_count);
+			m_spins.fetch_add(spins, std::memory_order_relaxed);
+			m_yields.fetch_add(poll - spins, std::memory_order_relaxed);
+		}
+
+		return task_accquiered;
+	}
+}
+
+template <typename policies>
+inline void basic_thread_pool<policies>::notify_pollers() {
+	if constexpr (polls) {
+		m_added_tasks_epoch.fetch_add(1, std::memory_order_release);
+	}
+}
+
+template <typename policies>
+inline bool basic_thread_pool<policies>::acquire_task(const std::size_t worker_index, queued_task& task) {
+	// Without prioritized tasks this load (of a line nobody writes then) is all the lanes cost.
+	if (m_prioritized_tasks.load(std::memory_order_acquire) == 0) {
+		return acquire_normal_task(worker_index, task);
+	}
+
+	return acquire_prioritized_task(worker_index, task);
+}
+
+template <typename policies>
+inline bool basic_thread_pool<policies>::acquire_prioritized_task(const std::size_t worker_index, queued_task& task) {
+	if (tl_priority_streak < priority_starvation_limit) {
+		if (acquire_lane_task(task_priority::high, task) || acquire_normal_task(worker_index, task) || acquire_lane_task(task_priority::low, task)) {
+			++tl_priority_streak;
+			return true;
+		}
+
+		return false;
+	}
+
+	// Starvation protection: this time the lowest non-empty lane goes first.
+	if (acquire_lane_task(task_priority::low, task)) {
+		lane(task_priority::low).starvation_runs.fetch_add(1, std::memory_order_relaxed);
+	}
+	else if (acquire_normal_task(worker_index, task)) {
+		if (lane(task_priority::high).queued.load(std::memory_order_relaxed) > 0) {
+			m_normal_starvation_runs.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	else if (!acquire_lane_task(task_priority::high, task)) {
+		return false;
+	}
+
+	tl_priority_streak = 0;
+	return true;
+}
+
+template <typename policies>
+inline bool basic_thread_pool<policies>::acquire_lane_task(const task_priority priority, queued_task& task) {
+	priority_lane& chosen_lane = lane(priority);
+
+	if (chosen_lane.queued.load(std::memory_order_acquire) == 0 || !chosen_lane.tasks.pop(task)) {
+		return false;
+	}
+
+	chosen_lane.queued.fetch_sub(1, std::memory_order_relaxed);
+	m_prioritized_tasks.fetch_sub(1, std::memory_order_relaxed);
+	return true;
+}
+
+template <typename policies>
+inline bool basic_thread_pool<policies>::acquire_normal_task(const std::size_t worker_index, queued_task& task) {
+	if (!uses_work_stealing()) {
+		return m_tasks.pop(task);
+	}
+
+	if (m_local_tasks[worker_index].pop(task)) {
+		return true;
+	}
+
+	// Deques past the live workers are empty: a worker only retires after finding no task anywhere, and tasks are only added to the deques of live workers.
+	const std::size_t local_queues_amount = m_live_workers.load(std::memory_order_acquire);
+	for (std::size_t offset = 1; offset < local_queues_amount; ++offset) {
+		if (m_local_tasks[(worker_index + offset) % local_queues_amount].steal(task)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template <typename policies>
+inline std::size_t basic_thread_pool<policies>::queued_tasks_amount() const {
+	return normal_queued_tasks_amount() + m_prioritized_tasks.load(std::memory_order_relaxed);
+}
+
+template <typename policies>
+inline std::size_t basic_thread_pool<policies>::normal_queued_tasks_amount() const {
+	if (!uses_work_stealing()) {
+		return m_tasks.size();
+	}
+
+	std::size_t amount = 0;
+	for (const auto& local_tasks : m_local_tasks) {
+		amount += local_tasks.size();
+	}
+
+	return amount;
+}
+
+template <typename policies>
+inline bool basic_thread_pool<policies>::uses_work_stealing() const {
+	if constexpr (fixed_mode) {
+		return policies::queue::value == scheduling_mode::work_stealing;
+	}
+	else {
+		return m_mode == scheduling_mode::work_stealing;
+	}
+}
+
+template <typename policies>
+inline wait_strategy basic_thread_pool<policies>::current_wait_strategy() const {
+	if constexpr (fixed_wait_strategy) {
+		return policies::wait::value;
+	}
+	else {
+		return m_wait_strategy;
+	}
+}
+
+template <typename policies>
+inline bool basic_thread_pool<policies>::may_run_tasks() const {
+	if constexpr (phased) {
+		return !m_paused && !m_phases.accepting_new_tasks;
+	}
+	else {
+		return !m_paused;
+	}
+}
+
+template <typename policies>
+inline bool basic_thread_pool<policies>::accepts_tasks_unsafe() const {
+	if constexpr (phased) {
+		return working_unsafe() && (m_paused || (m_phases.accepting_new_tasks && m_phases.active_tasks == 0));
+	}
+	else {
+		return working_unsafe();
+	}
+}
+
+template <typename policies>
+inline void basic_thread_pool<policies>::scaler_function() {
+	write_lock w_lock(m_rw_lock);
+
+	bool backlog = false;
+	bool rested = false;
+	auto backlog_since = std::chrono::steady_clock::now();
+
+	while (!m_terminated) {
+		const std::size_t queued = queued_tasks_amount();
+		const auto now = std::chrono::steady_clock::now();
+
+		// Queued tasks while some worker sleeps will be taken in a moment - only a queue nobody is free to drain is a backlog.
+		if (queued == 0 || m_sleeping_workers > 0) {
+			backlog = false;
+		}
+		else if (!backlog) {
+			backlog = true;
+			backlog_since = now;
+		}
+
+		if (backlog && m_live_workers < m_limits.max_workers && (queued > m_limits.queue_length_threshold || now - backlog_since >= m_limits.wait_threshold)) {
+			add_worker_unsafe();
+
+			// Give the new worker wait_threshold to catch up before adding another one.
+			backlog_since = now;
+		}
+
+		if (backlog) {
+			rested = false;
+			m_scaler_waiter.wait_until(w_lock, backlog_since + m_limits.wait_threshold);
+		}
+		else if (!rested) {
+			// Workers that are busy polling don't count as sleeping, so add_task may wake the scaler for nothing - check once more
+			// after wait_threshold before parking again, which limits such wakeups to one per wait_threshold.
+			rested = true;
+			m_scaler_waiter.wait_for(w_lock, m_limits.wait_threshold);
+		}
+		else {
+			// Woken by add_task when it finds no sleeping worker, or by terminate.
+			rested = false;
+			m_scaler_parked = true;
+			m_scaler_waiter.wait(w_lock);
+			m_scaler_parked = false;
+		}
+	}
+}
+
+template <typename policies>
+inline void basic_thread_pool<policies>::add_worker_unsafe() {
+	const std::size_t worker_index = m_live_workers;
+
+	// A retired worker decided to exit under the lock and doesn't touch the pool afterwards, so this join doesn't wait for the lock we hold.
+	if (m_workers[worker_index].joinable()) {
+		m_workers[worker_index].join();
+	}
+
+	m_workers[worker_index] = std::thread(&basic_thread_pool::routine, this, worker_index);
+	m_live_workers.store(worker_index + 1, std::memory_order_release);
+}
+
+template <typename policies>
+inline bool basic_thread_pool<policies>::may_retire_unsafe(const std::size_t worker_index) const {
+	// Only the newest worker retires, so the live workers always occupy the first slots (and deques).
+	return m_elastic && !m_terminated && worker_index + 1 == m_live_workers && m_live_workers > m_limits.min_workers;
+}
+
+template <typename policies>
+inline void basic_thread_pool<policies>::timer_function() {
+	write_lock w_lock(m_rw_lock);
+
+	while (true) {
+		// Waits on the condition instead of sleeping, so terminate() wakes it up at once.
+		const auto switch_at = std::chrono::steady_clock::now() + policies::phases::interval;
+		m_phases.timer_waiter.wait_until(w_lock, switch_at, [this] {
+			return m_terminated.load();
+		});
+
+		if (m_terminated) {
+			m_phases.accepting_new_tasks = false;
+			return;
+		}
+
+		bool prev_state = m_phases.accepting_new_tasks;
+		m_phases.accepting_new_tasks = !m_phases.accepting_new_tasks;
+
+		if (m_paused) {
+			m_phases.accepting_new_tasks = true;
+		}
+
+		if constexpr (logs) {
+			if (m_phases.accepting_new_tasks != prev_state) {
+				std::ostringstream ss; ss << "TP " << this << ": " << (m_phases.accepting_new_tasks ? "WANTS to START accepting new tasks - TP is NOT starting to execute existing tasks." : "is NOT ACCEPTING new tasks.") << "\n";
+				std::clog << ss.str();
+			}
+		}
+
+		if (!m_phases.accepting_new_tasks) {
+			m_task_waiter.notify_all();
+		}
+		else {
+			m_phases.timer_waiter.wait(w_lock, [this] {
+				return m_phases.active_tasks == 0 || m_terminated;
+			});
+
+			if constexpr (logs) {
+				if (m_phases.accepting_new_tasks != prev_state) {
+					std::ostringstream ss; ss << "TP " << this << ": is ACTUALLY ACCEPTING new tasks.\n";
+					std::clog << ss.str();
+				}
+			}
+		}
 	}
 }
 
-inline void thread_pool::set_paused(const bool paused) {
+template <typename policies>
+inline void basic_thread_pool<policies>::release_function() {
+	write_lock w_lock(m_rw_lock);
+
+	while (!m_terminated) {
+		const std::size_t staged = m_phases.staged_amount.load(std::memory_order_relaxed);
+
+		if (staged == 0) {
+			// Woken by the task that starts the next batch, or by terminate.
+			m_phases.timer_waiter.wait(w_lock);
+			continue;
+		}
+
+		const auto release_at = m_phases.first_staged_at.load(std::memory_order_relaxed) + policies::phases::max_delay;
+
+		if (staged >= policies::phases::max_batch_size || std::chrono::steady_clock::now() >= release_at) {
+			release_staged_unsafe();
+		}
+		else {
+			// Woken early by the task that fills the batch up.
+			m_phases.timer_waiter.wait_until(w_lock, release_at);
+		}
+	}
+}
+
+template <typename policies>
+inline bool basic_thread_pool<policies>::stage_unsafe(const std::size_t amount) {
+	const std::size_t staged_before = m_phases.staged_amount.fetch_add(amount, std::memory_order_relaxed);
+
+	if (staged_before == 0) {
+		m_phases.first_staged_at.store(std::chrono::steady_clock::now(), std::memory_order_relaxed);
+	}
+
+	// The release function only needs waking to start timing a new batch, or to release a full one early.
+	return staged_before == 0 || (staged_before < policies::phases::max_batch_size && staged_before + amount >= policies::phases::max_batch_size);
+}
+
+template <typename policies>
+inline void basic_thread_pool<policies>::release_staged_unsafe() {
+	// Under the write lock nobody is staging, so all the counted tasks are in the queue.
+	const std::size_t amount = m_phases.staged_amount.exchange(0, std::memory_order_relaxed);
+	if (amount == 0) {
+		return;
+	}
+
+	auto make_task = [this] {
+		queued_task task;
+		m_phases.staged.pop(task);
+		return task;
+	};
+	enqueue_batch_unsafe(amount, make_task);
+
+	notify_pollers();
+
+	const std::size_t workers_to_wake = (amount < m_sleeping_workers ? amount : m_sleeping_workers);
+	if (workers_to_wake > 0 && workers_to_wake == m_sleeping_workers) {
+		m_task_waiter.notify_all();
+	}
+	else {
+		for (std::size_t i = 0; i < workers_to_wake; ++i) {
+			m_task_waiter.notify_one();
+		}
+	}
+
+	if (m_scaler_parked && amount > m_sleeping_workers && m_live_workers < m_limits.max_workers) {
+		m_scaler_waiter.notify_one();
+	}
+}
+
+template <typename policies>
+inline void basic_thread_pool<policies>::set_paused(const bool paused) {
 	write_lock w_lock(m_rw_lock);
 
 	if (working_unsafe()) {
+		if constexpr (logs) {
+			std::ostringstream ss; ss << "TP " << this << ": SET PAUSED: " << (paused ? "TRUE" : "FALSE") << ". Previous value: " << (m_paused ? "TRUE" : "FALSE") << ".\n";
+			std::clog << ss.str();
+		}
+
 		m_paused = paused;
-		
+
 		if (!m_paused) {
 			m_task_waiter.notify_all();
 		}
 	}
 }
 
-inline bool thread_pool::is_paused() const {
+template <typename policies>
+inline bool basic_thread_pool<policies>::is_paused() const {
 	read_lock r_lock(m_rw_lock);
 	return m_paused;
 }
 
-inline bool thread_pool::working() const {
+template <typename policies>
+inline bool basic_thread_pool<policies>::accepting() const {
+	read_lock r_lock(m_rw_lock);
+	return accepting_unsafe();
+}
+
+template <typename policies>
+inline bool basic_thread_pool<policies>::accepting_unsafe() const {
+	return accepts_tasks_unsafe();
+}
+
+template <typename policies>
+inline bool basic_thread_pool<policies>::working() const {
 	read_lock r_lock(m_rw_lock);
 	return working_unsafe();
 }
 
-inline bool thread_pool::working_unsafe() const {
+template <typename policies>
+inline bool basic_thread_pool<policies>::working_unsafe() const {
 	return m_initialized && !m_terminated;
 }
 
+template <typename policies>
+inline std::size_t basic_thread_pool<policies>::worker_count() const {
+	return m_live_workers.load(std::memory_order_acquire);
+}
+
+template <typename policies>
+template <typename rep_t, typename period_t>
+inline bool basic_thread_pool<policies>::wait_idle_for(const std::chrono::duration<rep_t, period_t>& timeout) const {
+	return wait_idle_until(std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(timeout));
+}
+
+template <typename pool_t>
+inline bool schedule_awaiter<pool_t>::await_suspend(const std::coroutine_handle<> coroutine) {
+	// The coroutine may be resumed (and even finish) on a worker before add_task returns, so nothing of it is touched afterwards.
+	return m_pool.add_task([coroutine] { coroutine.resume(); });
+}
+
+template <typename policies>
+inline std::size_t basic_thread_pool<policies>::placement_groups() const {
+	if (m_placement != thread_placement::numa_nodes) {
+		return 1;
+	}
+
+	// Workers below min_workers never retire, and worker i runs on node i % nodes.
+	read_lock r_lock(m_rw_lock);
+	const std::size_t nodes_amount = processor_topology::get().node_count();
+	return (m_limits.min_workers < nodes_amount ? m_limits.min_workers : nodes_amount);
+}
+
+template <typename policies>
+inline std::size_t basic_thread_pool<policies>::placement_group_of_current_thread() const {
+	if (m_placement != thread_placement::numa_nodes) {
+		return 0;
+	}
+
+	return (tl_current_pool == this ? tl_worker_node : processor_topology::get().current_node());
+}
+
+template <typename policies>
+inline wait_counters basic_thread_pool<policies>::waiting_statistics() const {
+	return { m_spins.load(std::memory_order_relaxed), m_yields.load(std::memory_order_relaxed), m_parks.load(std::memory_order_relaxed) };
+}
+
+template <typename policies>
+inline thread_pool_snapshot basic_thread_pool<policies>::snapshot() const {
+	if constexpr (collects_statistics) {
+		// The lock only keeps initialize() from replacing the array; the workers keep recording while it is read.
+		read_lock r_lock(m_rw_lock);
+		return summarize_statistics(m_statistics.workers.get(), m_statistics.workers_amount);
+	}
+	else {
+		return {};
+	}
+}
+
+template <typename policies>
 template <typename task_t, typename... arguments>
-inline void thread_pool::add_task(task_t&& task, arguments&&... parameters) {
+inline bool basic_thread_pool<policies>::add_task(task_t&& task, arguments&&... parameters) {
+	bool wake_worker = true;
+	bool wake_scaler = false;
+	bool wake_timer = false;
+
 	{
 		read_lock r_lock(m_rw_lock);
 
-		if (!working_unsafe()) {
-			return;
+		if (!accepts_tasks_unsafe()) {
+			if constexpr (logs) {
+				std::ostringstream ss; ss << "TP " << this << ": REJECTING new task - " << typeid(task).name() << ".\n";
+				std::clog << ss.str();
+			}
+			return false;
+		}
+
+		if constexpr (logs) {
+			std::ostringstream ss; ss << "TP " << this << ": ACCEPTING new task - " << typeid(task).name() << ".\n";
+			std::clog << ss.str();
+		}
+
+		if constexpr (traces) {
+			trace_recorder::get().record("enqueue", "thread_pool", trace_phase::instant, 1);
+		}
+
+		m_unfinished_tasks.add();
+
+		if constexpr (batched) {
+			m_phases.staged.emplace(std::forward<task_t>(task), std::forward<arguments>(parameters)...);
+			wake_timer = stage_unsafe(1);
+			wake_worker = false;
+		}
+		else if (uses_work_stealing()) {
+			const std::size_t queue_index = (tl_current_pool == this) ? tl_worker_index : m_next_local_queue.fetch_add(1, std::memory_order_relaxed) % m_live_workers;
+			m_local_tasks[queue_index].emplace(std::forward<task_t>(task), std::forward<arguments>(parameters)...);
+
+			// Sleeping workers check the deques under the write lock, so under the read lock this can't miss a worker that is about to sleep.
+			wake_worker = m_sleeping_workers > 0;
+		}
+		else {
+			// Queued under the read lock too: a terminate() between counting and queueing would reset the counter
+			// while the task is still on its way into the queue, and the next initialize() would run it uncounted.
+			m_tasks.emplace(std::forward<task_t>(task), std::forward<arguments>(parameters)...);
+		}
+
+		wake_scaler = m_scaler_parked && m_sleeping_workers == 0 && m_live_workers < m_limits.max_workers;
+	}
+
+	if constexpr (batched) {
+		// The workers get the task with its batch.
+		if (wake_timer) {
+			m_phases.timer_waiter.notify_one();
+		}
+
+		return true;
+	}
+	else {
+		notify_pollers();
+
+		if (wake_worker) {
+			m_task_waiter.notify_one();
+		}
+
+		if (wake_scaler) {
+			m_scaler_waiter.notify_one();
+		}
+
+		return true;
+	}
+}
+
+template <typename policies>
+template <typename task_t, typename... arguments>
+inline bool basic_thread_pool<policies>::add_prioritized_task(const task_priority priority, task_t&& task, arguments&&... parameters) {
+	if (priority == task_priority::normal) {
+		return add_task(std::forward<task_t>(task), std::forward<arguments>(parameters)...);
+	}
+
+	priority_lane& chosen_lane = lane(priority);
+	bool wake_worker = false;
+	bool wake_scaler = false;
+
+	{
+		read_lock r_lock(m_rw_lock);
+
+		if (!accepts_tasks_unsafe()) {
+			if constexpr (logs) {
+				std::ostringstream ss; ss << "TP " << this << ": REJECTING new prioritized task - " << typeid(task).name() << ".\n";
+				std::clog << ss.str();
+			}
+			return false;
+		}
+
+		if constexpr (traces) {
+			trace_recorder::get().record(priority == task_priority::high ? "enqueue high" : "enqueue low", "thread_pool", trace_phase::instant, 1);
+		}
+
+		m_unfinished_tasks.add();
+
+		// Counted before the task is visible, so a worker that pops it never takes the counters below zero.
+		const std::size_t queued = chosen_lane.queued.fetch_add(1, std::memory_order_relaxed) + 1;
+		m_prioritized_tasks.fetch_add(1, std::memory_order_release);
+		chosen_lane.tasks.emplace(std::forward<task_t>(task), std::forward<arguments>(parameters)...);
+
+		chosen_lane.added.fetch_add(1, std::memory_order_relaxed);
+		if (queued > chosen_lane.max_queued.load(std::memory_order_relaxed)) {
+			chosen_lane.max_queued.store(queued, std::memory_order_relaxed);
+		}
+
+		// Enqueued under the read lock, like a work-stealing add_task, so the amount of sleeping workers is exact.
+		wake_worker = m_sleeping_workers > 0;
+		wake_scaler = m_scaler_parked && m_sleeping_workers == 0 && m_live_workers < m_limits.max_workers;
+	}
+
+	notify_pollers();
+
+	if (wake_worker) {
+		m_task_waiter.notify_one();
+	}
+
+	if (wake_scaler) {
+		m_scaler_waiter.notify_one();
+	}
+
+	return true;
+}
+
+template <typename policies>
+inline std::array<lane_statistics, task_priorities_amount> basic_thread_pool<policies>::lane_metrics() const {
+	std::array<lane_statistics, task_priorities_amount> metrics;
+
+	for (const task_priority priority : { task_priority::high, task_priority::low }) {
+		const priority_lane& chosen_lane = lane(priority);
+		lane_statistics& lane_metric = metrics[static_cast<std::size_t>(priority)];
+
+		lane_metric.queued			= chosen_lane.queued.load(std::memory_order_relaxed);
+		lane_metric.max_queued		= chosen_lane.max_queued.load(std::memory_order_relaxed);
+		lane_metric.added			= chosen_lane.added.load(std::memory_order_relaxed);
+		lane_metric.starvation_runs	= chosen_lane.starvation_runs.load(std::memory_order_relaxed);
+	}
+
+	// The normal lane keeps no counters of its own (add_task stays as it was), so only its current depth and starvation runs are known.
+	lane_statistics& normal = metrics[static_cast<std::size_t>(task_priority::normal)];
+
+	read_lock r_lock(m_rw_lock);
+	normal.queued = normal_queued_tasks_amount();
+	normal.starvation_runs = m_normal_starvation_runs.load(std::memory_order_relaxed);
+
+	return metrics;
+}
+
+template <typename policies>
+template <typename task_t, typename... arguments>
+inline task_future<submit_result<task_t, arguments...>> basic_thread_pool<policies>::submit(task_t&& task, arguments&&... parameters) {
+	auto [future, promised] = package_task(std::forward<task_t>(task), std::forward<arguments>(parameters)...);
+
+	// If the task is rejected, promised is destroyed here without running and the future gets broken_promise.
+	add_task(std::move(promised));
+	return std::move(future);
+}
+
+template <typename policies>
+template <typename iterator_t>
+inline std::size_t basic_thread_pool<policies>::add_tasks(iterator_t first, iterator_t last) {
+	auto make_task = [&first] { return unique_task(*first++); };
+	return add_task_batch_from(static_cast<std::size_t>(std::distance(first, last)), make_task);
+}
+
+template <typename policies>
+template <typename function_t>
+inline std::size_t basic_thread_pool<policies>::add_task_batch(const std::size_t amount, const function_t& function) {
+	auto make_task = [&function, index = std::size_t(0)]() mutable { return unique_task(function, index++); };
+	return add_task_batch_from(amount, make_task);
+}
+
+template <typename policies>
+template <typename factory_t>
+inline std::size_t basic_thread_pool<policies>::add_task_batch_from(const std::size_t amount, factory_t& make_task) {
+	if (amount == 0) {
+		return 0;
+	}
+
+	std::size_t workers_to_wake = 0;
+	bool wake_all = false;
+	bool wake_scaler = false;
+	bool wake_timer = false;
+
+	{
+		read_lock r_lock(m_rw_lock);
+
+		if (!accepts_tasks_unsafe()) {
+			if constexpr (logs) {
+				std::ostringstream ss; ss << "TP " << this << ": REJECTING a batch of " << amount << " new tasks.\n";
+				std::clog << ss.str();
+			}
+			return 0;
+		}
+
+		if constexpr (logs) {
+			std::ostringstream ss; ss << "TP " << this << ": ACCEPTING a batch of " << amount << " new tasks.\n";
+			std::clog << ss.str();
+		}
+
+		if constexpr (traces) {
+			trace_recorder::get().record("enqueue", "thread_pool", trace_phase::instant, amount);
+		}
+
+		m_unfinished_tasks.add(amount);
+
+		if constexpr (batched) {
+			m_phases.staged.emplace_batch(amount, make_task);
+			wake_timer = stage_unsafe(amount);
+		}
+		else {
+			enqueue_batch_unsafe(amount, make_task);
+		}
+
+		// Unlike add_task, both modes enqueue under the read lock here, so the amount of sleeping workers is exact
+		// and waking more of them than there are new tasks would be wasted.
+		if constexpr (!batched) {
+			workers_to_wake = (amount < m_sleeping_workers ? amount : m_sleeping_workers);
+			wake_all = workers_to_wake > 0 && workers_to_wake == m_sleeping_workers;
+			wake_scaler = m_scaler_parked && amount > m_sleeping_workers && m_live_workers < m_limits.max_workers;
+		}
+	}
+
+	if constexpr (batched) {
+		if (wake_timer) {
+			m_phases.timer_waiter.notify_one();
+		}
+
+		return amount;
+	}
+
+	notify_pollers();
+
+	if (wake_all) {
+		m_task_waiter.notify_all();
+	}
+	else {
+		for (std::size_t i = 0; i < workers_to_wake; ++i) {
+			m_task_waiter.notify_one();
 		}
 	}
 
-	auto bind = std::bind(std::forward<task_t>(task), std::forward<arguments>(parameters)...);
+	if (wake_scaler) {
+		m_scaler_waiter.notify_one();
+	}
+
+	return amount;
+}
+
+template <typename policies>
+template <typename factory_t>
+inline void basic_thread_pool<policies>::enqueue_batch_unsafe(const std::size_t amount, factory_t& make_task) {
+	if (uses_work_stealing()) {
+		// One contiguous slice per deque: every deque lock is taken once, and the woken workers find tasks without stealing.
+		const std::size_t queues_amount = m_live_workers;
+		const std::size_t first_queue = (tl_current_pool == this) ? tl_worker_index : m_next_local_queue.fetch_add(1, std::memory_order_relaxed) % queues_amount;
 
-	m_tasks.emplace(bind);
-	m_task_waiter.notify_one();
+		for (std::size_t i = 0; i < queues_amount && i < amount; ++i) {
+			const std::size_t slice = amount / queues_amount + (i < amount % queues_amount ? 1 : 0);
+			m_local_tasks[(first_queue + i) % queues_amount].emplace_batch(slice, make_task);
+		}
+	}
+	else {
+		m_tasks.emplace_batch(amount, make_task);
+	}
 }
\ No newline at end of file
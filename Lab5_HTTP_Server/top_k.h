@@ -0,0 +1,469 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "parallel_algorithms.h"
+#include "radix_select.h"
+#include "top_k_simd.h"
+
+// Up to this k the values are kept in a sorted block (an insertion moves a few neighbours), above it in a heap.
+constexpr std::size_t top_k_sorted_block_limit = 16;
+
+// Minimal amount of elements searched by one chunk of the parallel select_k.
+constexpr std::size_t top_k_grain = 16 * 1024;
+
+// select_k with a pool switches from top_k_values to radix_select for a k of at least top_k_radix_min_k that is at least
+// 1 / top_k_radix_max_fraction of the range (e.g. the top 1% of 100M values): merging the partial selections costs O(k log k)
+// per participant, while radix_select passes over the range a fixed amount of times.
+constexpr std::size_t top_k_radix_min_k			= 4 * 1024;
+constexpr std::size_t top_k_radix_max_fraction	= 1024;
+
+// How select_k with a pool selects: by the ratio of k to the range, or always one way (e.g. to compare them).
+enum class top_k_selection { automatic, heap, radix };
+
+inline top_k_selection top_k_selection_mode();
+inline void use_top_k_selection(const top_k_selection selection);
+
+inline const char* top_k_selection_name(const top_k_selection selection);
+
+// Whether select_k with a pool uses radix_select for k of size values (ranked by std::greater or std::less, of a radix_selectable type).
+inline bool top_k_uses_radix(const std::size_t size, const std::size_t k);
+
+// Which vector scan suits a comparator of top_k_values: 1 - for greater values (std::greater), -1 - for smaller ones (std::less),
+// 0 - none (any other comparator is only called element by element).
+template <typename compare_t, typename T>
+constexpr int top_k_scan_direction = (std::is_same_v<compare_t, std::greater<T>> || std::is_same_v<compare_t, std::greater<>>) ? 1
+	: ((std::is_same_v<compare_t, std::less<T>> || std::is_same_v<compare_t, std::less<>>) ? -1 : 0);
+
+// The k values of a stream that rank first, in O(k) memory: values are pushed one by one and never copied anywhere else.
+// compare(a, b) tells whether a ranks before b: std::greater (the default) keeps the k largest values, std::less the k smallest.
+// Once k values are kept, a new value costs one comparison with the last ranked of them (threshold()) unless it ranks before it,
+// so a pass over a large range is a sequential read with an almost always predicted branch. Contiguous ranges of int32_t, int64_t,
+// float and double kept by std::greater or std::less are scanned with vector compares (see top_k_simd.h): only the values beating
+// the threshold take the scalar path. NaNs are left out (see top_k_unranked) - they don't rank against anything, and one kept
+// NaN would stop every value after it from getting in.
+template <typename T, typename compare_t = std::greater<T>>
+class top_k_values {
+public:
+	inline explicit top_k_values(const std::size_t k = 0, const compare_t& compare = compare_t());
+
+	inline void push(const T& value);
+
+	template <typename iterator_t>
+	inline void push(iterator_t first, const iterator_t last);
+
+	// Keeps the k first ranked of both.
+	inline void merge(const top_k_values& other);
+
+	inline std::size_t k() const { return m_k; }
+	inline std::size_t size() const { return m_values.size(); }
+	inline bool full() const { return m_values.size() == m_k; }
+
+	// The last ranked kept value: a pushed value only gets in if it ranks before it. Only valid while size() > 0.
+	inline const T& threshold() const;
+
+	// The kept values in ranking order (the largest first with std::greater). Leaves the container empty.
+	inline std::vector<T> take_sorted();
+
+private:
+	inline void insert_sorted(const T& value);
+
+	inline void push_contiguous(const T* const values, const std::size_t count, const simd_level level);
+
+private:
+	std::size_t		m_k;
+	bool			m_sorted;	// m_values is sorted in ranking order (k <= top_k_sorted_block_limit), otherwise a heap with the last ranked on top.
+	std::vector<T>	m_values;
+	compare_t		m_compare;
+};
+
+// Compares elements by the keys projection picks from them.
+template <typename compare_t, typename projection_t>
+struct projected_compare {
+	compare_t		compare;
+	projection_t	projection;
+
+	template <typename T>
+	inline bool operator()(const T& lhs, const T& rhs) const {
+		return std::invoke(compare, std::invoke(projection, lhs), std::invoke(projection, rhs));
+	}
+};
+
+// Compares indices by the elements of values they point to; of two equal elements the one with the smaller index ranks first.
+template <typename T, typename compare_t, typename projection_t>
+struct indexed_compare {
+	const T*		values;
+	compare_t		compare;
+	projection_t	projection;
+
+	inline bool operator()(const std::size_t lhs, const std::size_t rhs) const {
+		decltype(auto) lhs_key = std::invoke(projection, values[lhs]);
+		decltype(auto) rhs_key = std::invoke(projection, values[rhs]);
+
+		if (std::invoke(compare, lhs_key, rhs_key)) {
+			return true;
+		}
+		if (std::invoke(compare, rhs_key, lhs_key)) {
+			return false;
+		}
+		return lhs < rhs;
+	}
+};
+
+// Whether top_k_values leaves value out: a NaN key (of the value itself, of what projection picks from it, of the element an index
+// points to) doesn't rank against anything.
+template <typename key_t>
+inline bool is_nan_key(const key_t& key) {
+	if constexpr (std::is_floating_point_v<std::remove_cvref_t<key_t>>) {
+		return key != key;
+	}
+	else {
+		return false;
+	}
+}
+
+template <typename compare_t, typename T>
+inline bool top_k_unranked(const compare_t&, const T& value) {
+	return is_nan_key(value);
+}
+
+template <typename compare_t, typename projection_t, typename T>
+inline bool top_k_unranked(const projected_compare<compare_t, projection_t>& compare, const T& value) {
+	return is_nan_key(std::invoke(compare.projection, value));
+}
+
+template <typename T, typename compare_t, typename projection_t>
+inline bool top_k_unranked(const indexed_compare<T, compare_t, projection_t>& compare, const std::size_t& index) {
+	return is_nan_key(std::invoke(compare.projection, compare.values[index]));
+}
+
+// The k elements of values (a span, vector, array - any contiguous range) that rank first by compare(projection(a), projection(b)),
+// in ranking order (all of them if there are fewer than k). With the defaults - the k largest (top-k); std::less<>() - the k smallest
+// (bottom-k); projection picks the key an element is ranked by (a member pointer, a function of the element).
+// The range is read once and not copied: a top_k_values keeps the selection.
+template <std::ranges::contiguous_range values_t, typename compare_t = std::greater<>, typename projection_t = std::identity>
+inline std::vector<std::ranges::range_value_t<values_t>> select_k(const values_t& values, const std::size_t k,
+	const compare_t& compare = compare_t(), const projection_t& projection = projection_t());
+
+// The same on the workers of pool and the calling thread. Every participant streams its chunks into its own top_k_values, so the range
+// is read once, nothing is shared until the partial selections are merged, and the extra memory is O(k * participants).
+// For a large k (see top_k_uses_radix) of plain numbers ranked by std::greater or std::less, radix_select is used instead,
+// and its result is sorted with parallel_sort.
+template <std::ranges::contiguous_range values_t, typename compare_t = std::greater<>, typename projection_t = std::identity>
+inline std::vector<std::ranges::range_value_t<values_t>> select_k(thread_pool& pool, const values_t& values, const std::size_t k,
+	const compare_t& compare = compare_t(), const projection_t& projection = projection_t(), const std::size_t grain = top_k_grain);
+
+// The element of values that ranks first (k = 1) - the first of equal ones, nullptr if there is none. Allocates nothing: the best
+// element so far is kept in place of a top_k_values, and the range is scanned with vector compares like top_k_values does.
+template <std::ranges::contiguous_range values_t, typename compare_t = std::greater<>, typename projection_t = std::identity>
+inline const std::ranges::range_value_t<values_t>* select_first(const values_t& values, const compare_t& compare = compare_t(), const projection_t& projection = projection_t());
+
+// Positions in values of the selected elements instead of the elements (arg-top-k), in ranking order.
+// Of equal elements the one with the smaller index ranks first, so the result doesn't depend on how the range was split.
+template <std::ranges::contiguous_range values_t, typename compare_t = std::greater<>, typename projection_t = std::identity>
+inline std::vector<std::size_t> select_k_indices(const values_t& values, const std::size_t k,
+	const compare_t& compare = compare_t(), const projection_t& projection = projection_t());
+
+template <std::ranges::contiguous_range values_t, typename compare_t = std::greater<>, typename projection_t = std::identity>
+inline std::vector<std::size_t> select_k_indices(thread_pool& pool, const values_t& values, const std::size_t k,
+	const compare_t& compare = compare_t(), const projection_t& projection = projection_t(), const std::size_t grain = top_k_grain);
+
+
+inline std::atomic<top_k_selection>& top_k_selection_storage() {
+	static std::atomic<top_k_selection> selection = top_k_selection::automatic;
+	return selection;
+}
+
+inline top_k_selection top_k_selection_mode() {
+	return top_k_selection_storage().load(std::memory_order_relaxed);
+}
+
+inline void use_top_k_selection(const top_k_selection selection) {
+	top_k_selection_storage().store(selection, std::memory_order_relaxed);
+}
+
+inline const char* top_k_selection_name(const top_k_selection selection) {
+	switch (selection) {
+	case top_k_selection::heap:		return "heap";
+	case top_k_selection::radix:	return "radix";
+	default:						return "automatic";
+	}
+}
+
+inline bool top_k_uses_radix(const std::size_t size, const std::size_t k) {
+	switch (top_k_selection_mode()) {
+	case top_k_selection::heap:		return false;
+	case top_k_selection::radix:	return true;
+	default:						return k >= top_k_radix_min_k && k >= size / top_k_radix_max_fraction;
+	}
+}
+
+template <typename T, typename compare_t>
+inline top_k_values<T, compare_t>::top_k_values(const std::size_t k, const compare_t& compare)
+	: m_k(k), m_sorted(k <= top_k_sorted_block_limit), m_compare(compare) {
+	m_values.reserve(k);
+}
+
+template <typename T, typename compare_t>
+inline void top_k_values<T, compare_t>::push(const T& value) {
+	if (top_k_unranked(m_compare, value)) {
+		return;
+	}
+
+	if (m_values.size() < m_k) {
+		if (m_sorted) {
+			insert_sorted(value);
+		}
+		else {
+			m_values.push_back(value);
+			std::push_heap(m_values.begin(), m_values.end(), m_compare);
+		}
+		return;
+	}
+
+	if (m_k == 0 || !m_compare(value, threshold())) {
+		return;
+	}
+
+	if (m_sorted) {
+		m_values.pop_back();
+		insert_sorted(value);
+	}
+	else {
+		std::pop_heap(m_values.begin(), m_values.end(), m_compare);
+		m_values.back() = value;
+		std::push_heap(m_values.begin(), m_values.end(), m_compare);
+	}
+}
+
+template <typename T, typename compare_t>
+template <typename iterator_t>
+inline void top_k_values<T, compare_t>::push(iterator_t first, const iterator_t last) {
+	if constexpr (top_k_simd_type<T> && top_k_scan_direction<compare_t, T> != 0 && std::contiguous_iterator<iterator_t> && std::is_same_v<std::iter_value_t<iterator_t>, T>) {
+		const simd_level level = top_k_simd_level();
+		if (level != simd_level::scalar) {
+			push_contiguous(std::to_address(first), static_cast<std::size_t>(last - first), level);
+			return;
+		}
+	}
+
+	for (; first != last; ++first) {
+		push(*first);
+	}
+}
+
+template <typename T, typename compare_t>
+inline void top_k_values<T, compare_t>::merge(const top_k_values& other) {
+	push(other.m_values.begin(), other.m_values.end());
+}
+
+template <typename T, typename compare_t>
+inline const T& top_k_values<T, compare_t>::threshold() const {
+	return m_sorted ? m_values.back() : m_values.front();
+}
+
+template <typename T, typename compare_t>
+inline std::vector<T> top_k_values<T, compare_t>::take_sorted() {
+	if (!m_sorted) {
+		std::sort_heap(m_values.begin(), m_values.end(), m_compare);
+	}
+
+	std::vector<T> values;
+	values.swap(m_values);
+
+	return values;
+}
+
+template <typename T, typename compare_t>
+inline void top_k_values<T, compare_t>::insert_sorted(const T& value) {
+	m_values.push_back(value);
+
+	std::size_t i = m_values.size() - 1;
+	for (; i > 0 && m_compare(value, m_values[i - 1]); --i) {
+		m_values[i] = m_values[i - 1];
+	}
+	m_values[i] = value;
+}
+
+template <typename T, typename compare_t>
+inline void top_k_values<T, compare_t>::push_contiguous(const T* const values, const std::size_t count, const simd_level level) {
+	std::size_t i = 0;
+
+	// Every value gets in until k are kept.
+	for (; i < count && m_values.size() < m_k; ++i) {
+		push(values[i]);
+	}
+
+	if (m_k == 0) {
+		return;
+	}
+
+	// The scan skips the values that don't beat the threshold, the one found replaces it.
+	while (i < count) {
+		if constexpr (top_k_scan_direction<compare_t, T> > 0) {
+			i += find_first_greater(values + i, count - i, threshold(), level);
+		}
+		else {
+			i += find_first_less(values + i, count - i, threshold(), level);
+		}
+
+		if (i < count) {
+			push(values[i]);
+			++i;
+		}
+	}
+}
+
+// compare itself when there is no projection, so top_k_values can still recognize std::greater and std::less.
+template <typename compare_t, typename projection_t>
+inline auto element_compare(const compare_t& compare, const projection_t& projection) {
+	if constexpr (std::is_same_v<projection_t, std::identity>) {
+		return compare;
+	}
+	else {
+		return projected_compare<compare_t, projection_t>{ compare, projection };
+	}
+}
+
+// Selects over [first, last) - pointers to elements, or indices (pushed as they are) - on pool, merging the partial selections.
+template <typename T, typename compare_t, typename index_t>
+inline std::vector<T> parallel_select(thread_pool& pool, const index_t first, const index_t last, const std::size_t k, const compare_t& compare, const std::size_t grain) {
+	using selection = top_k_values<T, compare_t>;
+
+	selection selected = parallel_reduce(pool, first, last, grain, selection(k, compare),
+		[](const index_t chunk_first, const index_t chunk_last, selection partial) {
+			if constexpr (std::is_integral_v<index_t>) {
+				const std::ranges::iota_view<index_t, index_t> indices(chunk_first, chunk_last);
+				partial.push(indices.begin(), indices.end());
+			}
+			else {
+				partial.push(chunk_first, chunk_last);
+			}
+			return partial;
+		},
+		[](selection result, selection partial) {
+			result.merge(partial);
+			return result;
+		});
+
+	return selected.take_sorted();
+}
+
+template <std::ranges::contiguous_range values_t, typename compare_t, typename projection_t>
+inline std::vector<std::ranges::range_value_t<values_t>> select_k(const values_t& values, const std::size_t k, const compare_t& compare, const projection_t& projection) {
+	using T = std::ranges::range_value_t<values_t>;
+
+	const auto ranking = element_compare(compare, projection);
+	top_k_values<T, std::remove_const_t<decltype(ranking)>> selected(k, ranking);
+
+	selected.push(std::ranges::data(values), std::ranges::data(values) + std::ranges::size(values));
+	return selected.take_sorted();
+}
+
+template <std::ranges::contiguous_range values_t, typename compare_t, typename projection_t>
+inline std::vector<std::ranges::range_value_t<values_t>> select_k(thread_pool& pool, const values_t& values, const std::size_t k, const compare_t& compare, const projection_t& projection, const std::size_t grain) {
+	using T = std::ranges::range_value_t<values_t>;
+
+	const T* const first = std::ranges::data(values);
+	const std::size_t size = std::ranges::size(values);
+
+	if constexpr (radix_selectable<T> && std::is_same_v<projection_t, std::identity> && top_k_scan_direction<compare_t, T> != 0) {
+		if (top_k_uses_radix(size, k)) {
+			std::vector<T> selected = radix_select<(top_k_scan_direction<compare_t, T> > 0)>(pool, first, size, k, grain);
+			parallel_sort(pool, selected.begin(), selected.end(), compare, grain);
+			return selected;
+		}
+	}
+
+	return parallel_select<T>(pool, first, first + size, k, element_compare(compare, projection), grain);
+}
+
+template <std::ranges::contiguous_range values_t, typename compare_t, typename projection_t>
+inline std::vector<std::size_t> select_k_indices(const values_t& values, const std::size_t k, const compare_t& compare, const projection_t& projection) {
+	using T = std::ranges::range_value_t<values_t>;
+
+	const indexed_compare<T, compare_t, projection_t> ranking{ std::ranges::data(values), compare, projection };
+	top_k_values<std::size_t, indexed_compare<T, compare_t, projection_t>> selected(k, ranking);
+
+	const std::ranges::iota_view<std::size_t, std::size_t> indices(0, std::ranges::size(values));
+	selected.push(indices.begin(), indices.end());
+	return selected.take_sorted();
+}
+
+template <std::ranges::contiguous_range values_t, typename compare_t, typename projection_t>
+inline std::vector<std::size_t> select_k_indices(thread_pool& pool, const values_t& values, const std::size_t k, const compare_t& compare, const projection_t& projection, const std::size_t grain) {
+	using T = std::ranges::range_value_t<values_t>;
+
+	const indexed_compare<T, compare_t, projection_t> ranking{ std::ranges::data(values), compare, projection };
+	const std::size_t size = std::ranges::size(values);
+
+	if constexpr (radix_selectable<T> && std::is_same_v<projection_t, std::identity> && top_k_scan_direction<compare_t, T> != 0) {
+		if (top_k_uses_radix(size, k)) {
+			std::vector<std::size_t> selected = radix_select_indices<(top_k_scan_direction<compare_t, T> > 0)>(pool, std::ranges::data(values), size, k, grain);
+			parallel_sort(pool, selected.begin(), selected.end(), ranking, grain);
+			return selected;
+		}
+	}
+
+	return parallel_select<std::size_t>(pool, std::size_t(0), size, k, ranking, grain);
+}
+
+template <std::ranges::contiguous_range values_t, typename compare_t, typename projection_t>
+inline const std::ranges::range_value_t<values_t>* select_first(const values_t& values, const compare_t& compare, const projection_t& projection) {
+	using T = std::ranges::range_value_t<values_t>;
+
+	const auto ranking = element_compare(compare, projection);
+	using ranking_t = std::remove_const_t<decltype(ranking)>;
+
+	const T* const first = std::ranges::data(values);
+	const std::size_t size = std::ranges::size(values);
+
+	std::size_t i = 0;
+	while (i < size && top_k_unranked(ranking, first[i])) {
+		++i;
+	}
+
+	if (i == size) {
+		return nullptr;
+	}
+
+	const T* best = first + i;
+	++i;
+
+	if constexpr (top_k_simd_type<T> && top_k_scan_direction<ranking_t, T> != 0) {
+		const simd_level level = top_k_simd_level();
+		if (level != simd_level::scalar) {
+			while (i < size) {
+				if constexpr (top_k_scan_direction<ranking_t, T> > 0) {
+					i += find_first_greater(first + i, size - i, *best, level);
+				}
+				else {
+					i += find_first_less(first + i, size - i, *best, level);
+				}
+
+				if (i < size) {
+					best = first + i;
+					++i;
+				}
+			}
+			return best;
+		}
+	}
+
+	for (; i < size; ++i) {
+		if (!top_k_unranked(ranking, first[i]) && ranking(first[i], *best)) {
+			best = first + i;
+		}
+	}
+
+	return best;
+}
\ No newline at end of file
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TOP_K_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC compiles any intrinsic as is; GCC and Clang only inside functions compiled for the instruction set.
+#if defined(TOP_K_SIMD_X86) && !defined(_MSC_VER)
+#define TOP_K_SIMD_TARGET(instruction_set) __attribute__((target(instruction_set)))
+#else
+#define TOP_K_SIMD_TARGET(instruction_set)
+#endif
+
+// Vector instructions usable by the top-k scan, from the slowest.
+enum class simd_level { scalar, avx2, avx512 };
+
+// Element types the vector kernels are written for; top_k_values of any other type always scans with scalar compares.
+template <typename T>
+constexpr bool top_k_simd_type = std::is_same_v<T, std::int32_t> || std::is_same_v<T, std::int64_t> || std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+// The best level the CPU and the OS (which has to save the wide registers on a context switch) support. Detected once.
+inline simd_level supported_simd_level();
+
+// Level the top-k scan uses: supported_simd_level() unless lowered by use_top_k_simd_level (e.g. to compare the kernels).
+inline simd_level top_k_simd_level();
+// A level above supported_simd_level() is lowered to it.
+inline void use_top_k_simd_level(const simd_level level);
+
+inline const char* simd_level_name(const simd_level level);
+
+// Index of the first of values[0, count) greater than threshold (count if there is none), comparing a whole vector of values
+// per instruction at the given level. A NaN is never found, like with operator< (top_k_values leaves NaNs out, see top_k.h).
+template <typename T>
+inline std::size_t find_first_greater(const T* const values, const std::size_t count, const T threshold, const simd_level level);
+
+// The same for the first value less than threshold.
+template <typename T>
+inline std::size_t find_first_less(const T* const values, const std::size_t count, const T threshold, const simd_level level);
+
+
+inline simd_level supported_simd_level() {
+	static const simd_level level = [] {
+#if defined(TOP_K_SIMD_X86) && defined(_MSC_VER)
+		int registers[4] = {};
+
+		__cpuid(registers, 1);
+		const bool os_saves_avx = (registers[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+		if (!os_saves_avx) {
+			return simd_level::scalar;
+		}
+
+		__cpuidex(registers, 7, 0);
+		const bool avx2 = (registers[1] & (1 << 5)) != 0;
+		const bool avx512 = (registers[1] & (1 << 16)) != 0 && (_xgetbv(0) & 0xE6) == 0xE6;
+
+		return avx512 ? simd_level::avx512 : (avx2 ? simd_level::avx2 : simd_level::scalar);
+#elif defined(TOP_K_SIMD_X86)
+		// Checks the OS support (XCR0) as well.
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx512f") ? simd_level::avx512 : (__builtin_cpu_supports("avx2") ? simd_level::avx2 : simd_level::scalar);
+#else
+		return simd_level::scalar;
+#endif
+	}();
+
+	return level;
+}
+
+inline std::atomic<simd_level>& top_k_simd_level_storage() {
+	static std::atomic<simd_level> level = supported_simd_level();
+	return level;
+}
+
+inline simd_level top_k_simd_level() {
+	return top_k_simd_level_storage().load(std::memory_order_relaxed);
+}
+
+inline void use_top_k_simd_level(const simd_level level) {
+	const simd_level supported = supported_simd_level();
+	top_k_simd_level_storage().store(level < supported ? level : supported, std::memory_order_relaxed);
+}
+
+inline const char* simd_level_name(const simd_level level) {
+	switch (level) {
+	case simd_level::avx2:		return "AVX2";
+	case simd_level::avx512:	return "AVX-512";
+	default:					return "scalar";
+	}
+}
+
+// less - looks for a value less than threshold instead of greater.
+template <bool less, typename T>
+inline std::size_t find_first_beyond_scalar(const T* const values, const std::size_t count, const T threshold) {
+	for (std::size_t i = 0; i < count; ++i) {
+		if (less ? values[i] < threshold : threshold < values[i]) {
+			return i;
+		}
+	}
+
+	return count;
+}
+
+#ifdef TOP_K_SIMD_X86
+
+// Per element type: lanes in a vector, broadcast of the threshold, and a bit per lane (the lowest bit - the first lane)
+// set if that lane of values is greater (less, with less) than the threshold.
+template <typename T>
+struct avx2_lanes;
+
+template <>
+struct avx2_lanes<std::int32_t> {
+	static constexpr std::size_t width = 8;
+	TOP_K_SIMD_TARGET("avx2") static inline __m256i broadcast(const std::int32_t value) { return _mm256_set1_epi32(value); }
+	template <bool less>
+	TOP_K_SIMD_TARGET("avx2") static inline std::uint64_t beyond_mask(const std::int32_t* const values, const __m256i threshold) {
+		const __m256i loaded = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+		return static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(less ? _mm256_cmpgt_epi32(threshold, loaded) : _mm256_cmpgt_epi32(loaded, threshold))));
+	}
+};
+
+template <>
+struct avx2_lanes<std::int64_t> {
+	static constexpr std::size_t width = 4;
+	TOP_K_SIMD_TARGET("avx2") static inline __m256i broadcast(const std::int64_t value) { return _mm256_set1_epi64x(value); }
+	template <bool less>
+	TOP_K_SIMD_TARGET("avx2") static inline std::uint64_t beyond_mask(const std::int64_t* const values, const __m256i threshold) {
+		const __m256i loaded = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values));
+		return static_cast<std::uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(less ? _mm256_cmpgt_epi64(threshold, loaded) : _mm256_cmpgt_epi64(loaded, threshold))));
+	}
+};
+
+template <>
+struct avx2_lanes<float> {
+	static constexpr std::size_t width = 8;
+	TOP_K_SIMD_TARGET("avx2") static inline __m256 broadcast(const float value) { return _mm256_set1_ps(value); }
+	template <bool less>
+	TOP_K_SIMD_TARGET("avx2") static inline std::uint64_t beyond_mask(const float* const values, const __m256 threshold) {
+		return static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values), threshold, less ? _CMP_LT_OQ : _CMP_GT_OQ)));
+	}
+};
+
+template <>
+struct avx2_lanes<double> {
+	static constexpr std::size_t width = 4;
+	TOP_K_SIMD_TARGET("avx2") static inline __m256d broadcast(const double value) { return _mm256_set1_pd(value); }
+	template <bool less>
+	TOP_K_SIMD_TARGET("avx2") static inline std::uint64_t beyond_mask(const double* const values, const __m256d threshold) {
+		return static_cast<std::uint32_t>(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values), threshold, less ? _CMP_LT_OQ : _CMP_GT_OQ)));
+	}
+};
+
+template <typename T>
+struct avx512_lanes;
+
+template <>
+struct avx512_lanes<std::int32_t> {
+	static constexpr std::size_t width = 16;
+	TOP_K_SIMD_TARGET("avx512f") static inline __m512i broadcast(const std::int32_t value) { return _mm512_set1_epi32(value); }
+	template <bool less>
+	TOP_K_SIMD_TARGET("avx512f") static inline std::uint64_t beyond_mask(const std::int32_t* const values, const __m512i threshold) {
+		return less ? _mm512_cmplt_epi32_mask(_mm512_loadu_si512(values), threshold) : _mm512_cmpgt_epi32_mask(_mm512_loadu_si512(values), threshold);
+	}
+};
+
+template <>
+struct avx512_lanes<std::int64_t> {
+	static constexpr std::size_t width = 8;
+	TOP_K_SIMD_TARGET("avx512f") static inline __m512i broadcast(const std::int64_t value) { return _mm512_set1_epi64(value); }
+	template <bool less>
+	TOP_K_SIMD_TARGET("avx512f") static inline std::uint64_t beyond_mask(const std::int64_t* const values, const __m512i threshold) {
+		return less ? _mm512_cmplt_epi64_mask(_mm512_loadu_si512(values), threshold) : _mm512_cmpgt_epi64_mask(_mm512_loadu_si512(values), threshold);
+	}
+};
+
+template <>
+struct avx512_lanes<float> {
+	static constexpr std::size_t width = 16;
+	TOP_K_SIMD_TARGET("avx512f") static inline __m512 broadcast(const float value) { return _mm512_set1_ps(value); }
+	template <bool less>
+	TOP_K_SIMD_TARGET("avx512f") static inline std::uint64_t beyond_mask(const float* const values, const __m512 threshold) {
+		return _mm512_cmp_ps_mask(_mm512_loadu_ps(values), threshold, less ? _CMP_LT_OQ : _CMP_GT_OQ);
+	}
+};
+
+template <>
+struct avx512_lanes<double> {
+	static constexpr std::size_t width = 8;
+	TOP_K_SIMD_TARGET("avx512f") static inline __m512d broadcast(const double value) { return _mm512_set1_pd(value); }
+	template <bool less>
+	TOP_K_SIMD_TARGET("avx512f") static inline std::uint64_t beyond_mask(const double* const values, const __m512d threshold) {
+		return _mm512_cmp_pd_mask(_mm512_loadu_pd(values), threshold, less ? _CMP_LT_OQ : _CMP_GT_OQ);
+	}
+};
+
+// Four vectors per iteration, so the loop has one (almost never taken) branch per 4 * width values and the loads keep the memory busy.
+// The two kernels are the same loop compiled for different instruction sets - GCC doesn't let one function serve both.
+template <bool less, typename T>
+TOP_K_SIMD_TARGET("avx2") inline std::size_t find_first_beyond_avx2(const T* const values, const std::size_t count, const T threshold) {
+	using lanes = avx2_lanes<T>;
+	constexpr std::size_t width = lanes::width;
+
+	const auto threshold_vector = lanes::broadcast(threshold);
+	std::size_t i = 0;
+
+	for (; i + 4 * width <= count; i += 4 * width) {
+		const std::uint64_t mask = lanes::template beyond_mask<less>(values + i, threshold_vector) | (lanes::template beyond_mask<less>(values + i + width, threshold_vector) << width)
+			| (lanes::template beyond_mask<less>(values + i + 2 * width, threshold_vector) << (2 * width)) | (lanes::template beyond_mask<less>(values + i + 3 * width, threshold_vector) << (3 * width));
+		if (mask != 0) {
+			return i + static_cast<std::size_t>(std::countr_zero(mask));
+		}
+	}
+
+	return i + find_first_beyond_scalar<less>(values + i, count - i, threshold);
+}
+
+template <bool less, typename T>
+TOP_K_SIMD_TARGET("avx512f") inline std::size_t find_first_beyond_avx512(const T* const values, const std::size_t count, const T threshold) {
+	using lanes = avx512_lanes<T>;
+	constexpr std::size_t width = lanes::width;
+
+	const auto threshold_vector = lanes::broadcast(threshold);
+	std::size_t i = 0;
+
+	for (; i + 4 * width <= count; i += 4 * width) {
+		const std::uint64_t mask = lanes::template beyond_mask<less>(values + i, threshold_vector) | (lanes::template beyond_mask<less>(values + i + width, threshold_vector) << width)
+			| (lanes::template beyond_mask<less>(values + i + 2 * width, threshold_vector) << (2 * width)) | (lanes::template beyond_mask<less>(values + i + 3 * width, threshold_vector) << (3 * width));
+		if (mask != 0) {
+			return i + static_cast<std::size_t>(std::countr_zero(mask));
+		}
+	}
+
+	return i + find_first_beyond_scalar<less>(values + i, count - i, threshold);
+}
+
+#endif
+
+template <bool less, typename T>
+inline std::size_t find_first_beyond(const T* const values, const std::size_t count, const T threshold, const simd_level level) {
+#ifdef TOP_K_SIMD_X86
+	if constexpr (top_k_simd_type<T>) {
+		switch (level) {
+		case simd_level::avx512:	return find_first_beyond_avx512<less>(values, count, threshold);
+		case simd_level::avx2:		return find_first_beyond_avx2<less>(values, count, threshold);
+		default:					break;
+		}
+	}
+#endif
+
+	return find_first_beyond_scalar<less>(values, count, threshold);
+}
+
+template <typename T>
+inline std::size_t find_first_greater(const T* const values, const std::size_t count, const T threshold, const simd_level level) {
+	return find_first_beyond<false>(values, count, threshold, level);
+}
+
+template <typename T>
+inline std::size_t find_first_less(const T* const values, const std::size_t count, const T threshold, const simd_level level) {
+	return find_first_beyond<true>(values, count, threshold, level);
+}
\ No newline at end of file
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent_queue.h"
+
+// Events kept per thread; older events are overwritten. A thread's buffer is only allocated once it records its first event.
+constexpr std::size_t trace_buffer_capacity = std::size_t(1) << 14;
+
+// Kinds of the Chrome trace-event format: begin / end of a span on the recording thread, or a single point in time.
+enum class trace_phase : char { begin = 'B', end = 'E', instant = 'i' };
+
+// Timeline of what every thread did, written as Chrome trace-event JSON (open it in chrome://tracing or ui.perfetto.dev).
+// Recording is off until start(); while it is off, record() is a single relaxed load. Every thread records into its own ring buffer,
+// without locks and without touching the buffers of others; the lock is only taken when a thread records for the first time and
+// while a trace is written. Names and categories must be string literals (or outlive the recorder) - only the pointers are stored.
+class trace_recorder {
+public:
+	inline static trace_recorder& get();
+
+public:
+	inline void start() { m_enabled.store(true, std::memory_order_relaxed); }
+	inline void stop() { m_enabled.store(false, std::memory_order_relaxed); }
+	inline bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+	// argument is shown as args.id of the event (e.g. a socket or a task number).
+	inline void record(const char* const name, const char* const category, const trace_phase phase, const std::uint64_t argument = 0);
+
+	// Writes the events currently in the buffers, while the threads keep recording. Events overwritten in the meantime are left out.
+	inline void write_chrome_trace(std::ostream& output) const;
+	// Returns false if the file can't be written.
+	inline bool write_chrome_trace(const std::string& path) const;
+
+	// Starts recording, and writes the trace to path on every Enter on the console (a detached thread reads standard input).
+	inline void write_on_enter(const std::string& path);
+
+public:
+	inline trace_recorder(const trace_recorder& other) = delete;
+	inline trace_recorder& operator=(const trace_recorder& rhs) = delete;
+
+private:
+	inline trace_recorder() : m_origin(std::chrono::steady_clock::now()) {}
+
+	// Single-writer ring. Fields are relaxed atomics, so a writer overwriting a slot the trace is just copying can't tear it:
+	// write_chrome_trace checks written after the copy and drops the slots that may have changed (like the reader of a seqlock).
+	struct event_slot {
+		std::atomic<const char*>	name		= nullptr;
+		std::atomic<const char*>	category	= nullptr;
+		std::atomic<std::uint64_t>	timestamp	= 0;
+		std::atomic<std::uint64_t>	argument	= 0;
+		std::atomic<trace_phase>	phase		= trace_phase::instant;
+	};
+
+	struct thread_buffer {
+		inline explicit thread_buffer(const std::size_t thread_id_) : thread_id(thread_id_), events(std::make_unique<event_slot[]>(trace_buffer_capacity)) {}
+
+		const std::size_t						thread_id;
+		alignas(cache_line_size) std::atomic<std::uint64_t>	written		= 0;
+		std::unique_ptr<event_slot[]>			events;
+	};
+
+	inline thread_buffer& local_buffer();
+
+	std::atomic<bool>									m_enabled	= false;
+	const std::chrono::steady_clock::time_point			m_origin;
+
+	// Buffers of exited threads stay, so their events still make it into the trace.
+	mutable std::mutex									m_buffers_mutex;
+	std::vector<std::unique_ptr<thread_buffer>>			m_buffers;
+
+	inline static thread_local thread_buffer*			tl_buffer	= nullptr;
+};
+
+// Span from construction to destruction (or finish()), recorded only if the recorder was on when it started.
+class trace_scope {
+public:
+	inline trace_scope(const char* const name, const char* const category, const std::uint64_t argument = 0);
+	inline ~trace_scope();
+
+	// Ends the span before the end of the scope.
+	inline void finish();
+
+public:
+	inline trace_scope(const trace_scope& other) = delete;
+	inline trace_scope& operator=(const trace_scope& rhs) = delete;
+
+private:
+	const char* const	m_name;
+	const char* const	m_category;
+	bool				m_recorded;
+};
+
+
+inline trace_recorder& trace_recorder::get() {
+	static trace_recorder recorder;
+	return recorder;
+}
+
+inline void trace_recorder::record(const char* const name, const char* const category, const trace_phase phase, const std::uint64_t argument) {
+	if (!enabled()) {
+		return;
+	}
+
+	const std::uint64_t timestamp = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_origin).count());
+
+	thread_buffer& buffer = local_buffer();
+	const std::uint64_t index = buffer.written.load(std::memory_order_relaxed);
+
+	// Orders the written of the previous event before the stores below: write_chrome_trace, seeing any of them, also sees
+	// that this slot is being overwritten.
+	std::atomic_thread_fence(std::memory_order_release);
+
+	event_slot& slot = buffer.events[index % trace_buffer_capacity];
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.category.store(category, std::memory_order_relaxed);
+	slot.timestamp.store(timestamp, std::memory_order_relaxed);
+	slot.argument.store(argument, std::memory_order_relaxed);
+	slot.phase.store(phase, std::memory_order_relaxed);
+
+	buffer.written.store(index + 1, std::memory_order_release);
+}
+
+inline trace_recorder::thread_buffer& trace_recorder::local_buffer() {
+	if (tl_buffer == nullptr) {
+		std::lock_guard<std::mutex> lock(m_buffers_mutex);
+
+		m_buffers.push_back(std::make_unique<thread_buffer>(m_buffers.size() + 1));
+		tl_buffer = m_buffers.back().get();
+	}
+
+	return *tl_buffer;
+}
+
+inline void trace_recorder::write_chrome_trace(std::ostream& output) const {
+	struct copied_event {
+		const char*		name;
+		const char*		category;
+		std::uint64_t	timestamp;
+		std::uint64_t	argument;
+		trace_phase		phase;
+	};
+
+	std::lock_guard<std::mutex> lock(m_buffers_mutex);
+
+	output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	bool first = true;
+
+	std::vector<copied_event> copied;
+	copied.reserve(trace_buffer_capacity);
+
+	for (const std::unique_ptr<thread_buffer>& buffer : m_buffers) {
+		const std::uint64_t written = buffer->written.load(std::memory_order_acquire);
+		const std::uint64_t oldest = (written > trace_buffer_capacity ? written - trace_buffer_capacity : 0);
+
+		copied.clear();
+		for (std::uint64_t index = oldest; index < written; ++index) {
+			const event_slot& slot = buffer->events[index % trace_buffer_capacity];
+			copied.push_back({ slot.name.load(std::memory_order_relaxed), slot.category.load(std::memory_order_relaxed),
+				slot.timestamp.load(std::memory_order_relaxed), slot.argument.load(std::memory_order_relaxed), slot.phase.load(std::memory_order_relaxed) });
+		}
+
+		// Slots the writer has moved on to since the copy started may hold newer events: only the ones it can't have reached are kept.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const std::uint64_t written_after = buffer->written.load(std::memory_order_relaxed);
+		const std::uint64_t first_intact = (written_after + 1 > trace_buffer_capacity ? written_after + 1 - trace_buffer_capacity : 0);
+
+		output << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id
+			<< ",\"args\":{\"name\":\"thread " << buffer->thread_id << "\"}}";
+		first = false;
+
+		for (std::uint64_t index = (first_intact > oldest ? first_intact : oldest); index < written; ++index) {
+			const copied_event& event = copied[index - oldest];
+
+			output << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"" << static_cast<char>(event.phase)
+				<< "\",\"ts\":" << event.timestamp / 1000 << '.' << static_cast<char>('0' + event.timestamp / 100 % 10) << static_cast<char>('0' + event.timestamp / 10 % 10) << static_cast<char>('0' + event.timestamp % 10)
+				<< ",\"pid\":1,\"tid\":" << buffer->thread_id;
+
+			if (event.phase == trace_phase::instant) {
+				output << ",\"s\":\"t\"";
+			}
+
+			output << ",\"args\":{\"id\":" << event.argument << "}}";
+		}
+	}
+
+	output << "\n]}\n";
+}
+
+inline bool trace_recorder::write_chrome_trace(const std::string& path) const {
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file) {
+		return false;
+	}
+
+	write_chrome_trace(file);
+	return static_cast<bool>(file);
+}
+
+inline void trace_recorder::write_on_enter(const std::string& path) {
+	start();
+
+	std::thread([this, path] {
+		std::string line;
+		while (std::getline(std::cin, line)) {
+			const bool written = write_chrome_trace(path);
+			std::cout << (written ? "Trace written to " : "Couldn't write the trace to ") << path << "\n";
+		}
+	}).detach();
+}
+
+inline trace_scope::trace_scope(const char* const name, const char* const category, const std::uint64_t argument)
+	: m_name(name), m_category(category), m_recorded(trace_recorder::get().enabled()) {
+	if (m_recorded) {
+		trace_recorder::get().record(m_name, m_category, trace_phase::begin, argument);
+	}
+}
+
+inline trace_scope::~trace_scope() {
+	finish();
+}
+
+inline void trace_scope::finish() {
+	if (m_recorded) {
+		trace_recorder::get().record(m_name, m_category, trace_phase::end);
+		m_recorded = false;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Recycles the memory of task callables that don't fit into the inline buffer of unique_task.
+// Blocks are grouped into size classes. Every thread keeps a small cache per class and exchanges whole batches with a shared list,
+// so the shared lock is taken at most once per m_batch_size tasks, and after warm-up the heap is not touched at all
+// (blocks freed by workers flow back to the submitting threads through the shared list).
+class task_memory_pool {
+public:
+	inline static void* allocate(const std::size_t size);
+	inline static void deallocate(void* const block, const std::size_t size);
+
+private:
+	static constexpr std::size_t m_smallest_block_size	= 128;
+	static constexpr std::size_t m_size_classes_amount	= 4;	// 128, 256, 512 and 1024 bytes; larger callables use plain operator new.
+	static constexpr std::size_t m_batch_size			= 32;
+
+	struct shared_list {
+		inline ~shared_list();
+
+		std::mutex			mutex;
+		std::vector<void*>	blocks;
+	};
+
+	struct local_cache {
+		inline local_cache();
+		inline ~local_cache();
+
+		std::vector<void*>	blocks[m_size_classes_amount];
+	};
+
+	inline static std::size_t size_class(const std::size_t size);
+	inline static std::size_t block_size(const std::size_t size_class_index) { return m_smallest_block_size << size_class_index; }
+
+	inline static shared_list* shared_lists();
+	inline static local_cache& cache();
+};
+
+// A callable together with its bound arguments. The arguments are passed as rvalues, so it is meant to be called once.
+template <typename function_t, typename... arguments_t>
+struct bound_call {
+	function_t					function;
+	std::tuple<arguments_t...>	arguments;
+
+	inline decltype(auto) operator()() {
+		return std::apply([this](arguments_t&... parameters) -> decltype(auto) {
+			return std::invoke(std::move(function), std::move(parameters)...);
+		}, arguments);
+	}
+};
+
+// Move-only replacement of std::function<void()> for thread pool tasks.
+// The callable and its bound arguments are stored in an inline buffer when they fit (typical tasks - a member function pointer,
+// an object pointer and a few scalars - do), otherwise in a block of task_memory_pool. Unlike std::function + std::bind
+// the callable is never copied, so move-only callables and arguments (e.g. std::unique_ptr, std::promise) are supported.
+// Arguments are passed to the callable as rvalues, the same way std::thread passes them - use std::ref to pass a reference.
+// A task is meant to be invoked once.
+class unique_task {
+public:
+	// The whole task occupies one 64-byte cache line on 64-bit platforms.
+	static constexpr std::size_t size_in_bytes		= 64;
+	static constexpr std::size_t inline_capacity	= size_in_bytes - sizeof(void*);
+
+public:
+	inline unique_task() noexcept = default;
+	inline ~unique_task() { reset(); }
+
+	template <typename task_t, typename... arguments, typename = std::enable_if_t<!std::is_same_v<std::decay_t<task_t>, unique_task>>>
+	inline unique_task(task_t&& task, arguments&&... parameters);
+
+	inline unique_task(unique_task&& other) noexcept;
+	inline unique_task& operator=(unique_task&& rhs) noexcept;
+
+	inline void operator()();
+	inline explicit operator bool() const noexcept { return m_operations != nullptr; }
+
+	inline void reset() noexcept;
+
+	// Tells whether a callable of the given type is stored without touching task_memory_pool.
+	template <typename callable_t>
+	inline static constexpr bool stored_inline() {
+		return sizeof(callable_t) <= inline_capacity && alignof(callable_t) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<callable_t>;
+	}
+
+public:
+	inline unique_task(const unique_task& other) = delete;
+	inline unique_task& operator=(const unique_task& rhs) = delete;
+
+private:
+	struct operations {
+		void (*invoke)(void* storage);
+		void (*relocate)(void* destination, void* source) noexcept;	// Move-constructs into destination and destroys source.
+		void (*destroy)(void* storage) noexcept;
+	};
+
+	template <typename callable_t>
+	struct inline_operations {
+		inline static callable_t* get(void* storage) { return std::launder(reinterpret_cast<callable_t*>(storage)); }
+
+		inline static void invoke(void* storage) { (*get(storage))(); }
+		inline static void relocate(void* destination, void* source) noexcept {
+			::new (destination) callable_t(std::move(*get(source)));
+			std::destroy_at(get(source));
+		}
+		inline static void destroy(void* storage) noexcept { std::destroy_at(get(storage)); }
+
+		static constexpr operations table = { &invoke, &relocate, &destroy };
+	};
+
+	template <typename callable_t>
+	struct pooled_operations {
+		inline static callable_t*& get(void* storage) { return *std::launder(reinterpret_cast<callable_t**>(storage)); }
+
+		inline static void invoke(void* storage) { (*get(storage))(); }
+		inline static void relocate(void* destination, void* source) noexcept { ::new (destination) callable_t*(get(source)); }
+		inline static void destroy(void* storage) noexcept {
+			callable_t* const callable = get(storage);
+			std::destroy_at(callable);
+
+			if constexpr (alignof(callable_t) <= alignof(std::max_align_t)) {
+				task_memory_pool::deallocate(callable, sizeof(callable_t));
+			}
+			else {
+				::operator delete(callable, std::align_val_t(alignof(callable_t)));
+			}
+		}
+
+		static constexpr operations table = { &invoke, &relocate, &destroy };
+	};
+
+	template <typename callable_t, typename... arguments>
+	inline void store(arguments&&... parameters);
+
+	alignas(std::max_align_t) unsigned char	m_storage[inline_capacity];
+	const operations*						m_operations = nullptr;
+};
+
+
+inline task_memory_pool::shared_list::~shared_list() {
+	for (void* block : blocks) {
+		::operator delete(block);
+	}
+}
+
+inline task_memory_pool::local_cache::local_cache() {
+	// Make sure the shared lists outlive the thread caches that return their blocks to them.
+	shared_lists();
+
+	for (auto& class_blocks : blocks) {
+		class_blocks.reserve(2 * m_batch_size);
+	}
+}
+
+inline task_memory_pool::local_cache::~local_cache() {
+	for (std::size_t i = 0; i < m_size_classes_amount; ++i) {
+		shared_list& list = shared_lists()[i];
+
+		std::lock_guard<std::mutex> lock(list.mutex);
+		list.blocks.insert(list.blocks.end(), blocks[i].begin(), blocks[i].end());
+	}
+}
+
+inline std::size_t task_memory_pool::size_class(const std::size_t size) {
+	std::size_t size_class_index = 0;
+	while (size_class_index < m_size_classes_amount && block_size(size_class_index) < size) {
+		++size_class_index;
+	}
+
+	return size_class_index;
+}
+
+inline task_memory_pool::shared_list* task_memory_pool::shared_lists() {
+	static shared_list lists[m_size_classes_amount];
+	return lists;
+}
+
+inline task_memory_pool::local_cache& task_memory_pool::cache() {
+	thread_local local_cache thread_cache;
+	return thread_cache;
+}
+
+inline void* task_memory_pool::allocate(const std::size_t size) {
+	const std::size_t size_class_index = size_class(size);
+	if (size_class_index == m_size_classes_amount) {
+		return ::operator new(size);
+	}
+
+	std::vector<void*>& local_blocks = cache().blocks[size_class_index];
+
+	if (local_blocks.empty()) {
+		shared_list& list = shared_lists()[size_class_index];
+
+		std::lock_guard<std::mutex> lock(list.mutex);
+		const std::size_t taken = (list.blocks.size() < m_batch_size ? list.blocks.size() : m_batch_size);
+		local_blocks.insert(local_blocks.end(), list.blocks.end() - taken, list.blocks.end());
+		list.blocks.resize(list.blocks.size() - taken);
+	}
+
+	if (local_blocks.empty()) {
+		return ::operator new(block_size(size_class_index));
+	}
+
+	void* const block = local_blocks.back();
+	local_blocks.pop_back();
+	return block;
+}
+
+inline void task_memory_pool::deallocate(void* const block, const std::size_t size) {
+	const std::size_t size_class_index = size_class(size);
+	if (size_class_index == m_size_classes_amount) {
+		::operator delete(block);
+		return;
+	}
+
+	std::vector<void*>& local_blocks = cache().blocks[size_class_index];
+	local_blocks.push_back(block);
+
+	if (local_blocks.size() >= 2 * m_batch_size) {
+		shared_list& list = shared_lists()[size_class_index];
+
+		std::lock_guard<std::mutex> lock(list.mutex);
+		list.blocks.insert(list.blocks.end(), local_blocks.end() - m_batch_size, local_blocks.end());
+		local_blocks.resize(local_blocks.size() - m_batch_size);
+	}
+}
+
+template <typename task_t, typename... arguments, typename>
+inline unique_task::unique_task(task_t&& task, arguments&&... parameters) {
+	if constexpr (sizeof...(arguments) == 0) {
+		store<std::decay_t<task_t>>(std::forward<task_t>(task));
+	}
+	else {
+		store<bound_call<std::decay_t<task_t>, std::decay_t<arguments>...>>(std::forward<task_t>(task), std::forward_as_tuple(std::forward<arguments>(parameters)...));
+	}
+}
+
+inline unique_task::unique_task(unique_task&& other) noexcept : m_operations(other.m_operations) {
+	if (m_operations != nullptr) {
+		m_operations->relocate(m_storage, other.m_storage);
+		other.m_operations = nullptr;
+	}
+}
+
+inline unique_task& unique_task::operator=(unique_task&& rhs) noexcept {
+	if (this != &rhs) {
+		reset();
+
+		if (rhs.m_operations != nullptr) {
+			rhs.m_operations->relocate(m_storage, rhs.m_storage);
+			m_operations = rhs.m_operations;
+			rhs.m_operations = nullptr;
+		}
+	}
+
+	return *this;
+}
+
+inline void unique_task::operator()() {
+	m_operations->invoke(m_storage);
+}
+
+inline void unique_task::reset() noexcept {
+	if (m_operations != nullptr) {
+		m_operations->destroy(m_storage);
+		m_operations = nullptr;
+	}
+}
+
+template <typename callable_t, typename... arguments>
+inline void unique_task::store(arguments&&... parameters) {
+	if constexpr (stored_inline<callable_t>()) {
+		::new (static_cast<void*>(m_storage)) callable_t{ std::forward<arguments>(parameters)... };
+		m_operations = &inline_operations<callable_t>::table;
+	}
+	else {
+		constexpr bool pooled = alignof(callable_t) <= alignof(std::max_align_t);
+
+		void* block = nullptr;
+		if constexpr (pooled) {
+			block = task_memory_pool::allocate(sizeof(callable_t));
+		}
+		else {
+			block = ::operator new(sizeof(callable_t), std::align_val_t(alignof(callable_t)));
+		}
+
+		callable_t* callable = nullptr;
+		try {
+			callable = ::new (block) callable_t{ std::forward<arguments>(parameters)... };
+		}
+		catch (...) {
+			if constexpr (pooled) {
+				task_memory_pool::deallocate(block, sizeof(callable_t));
+			}
+			else {
+				::operator delete(block, std::align_val_t(alignof(callable_t)));
+			}
+			throw;
+		}
+
+		::new (static_cast<void*>(m_storage)) callable_t*(callable);
+		m_operations = &pooled_operations<callable_t>::table;
+	}
+}
\ No newline at end of file
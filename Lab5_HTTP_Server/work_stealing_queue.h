@@ -0,0 +1,108 @@
+#pragma once
+
+#include <mutex>
+
+#include "concurrent_queue.h"
+#include "circular_buffer.h"
+
+// Per-worker task deque used by the work-stealing mode of thread_pool.
+// The owner worker takes tasks from the front (keeping submission order), other workers steal from the back,
+// so the owner and thieves only compete for the same element when the deque is almost empty.
+// Every deque has its own lock and occupies its own cache line(s), so dequeues of different workers never touch shared state.
+template <typename type>
+class alignas(cache_line_size) work_stealing_queue {
+	using work_stealing_queue_implementation = circular_buffer<type>;
+
+public:
+	inline work_stealing_queue() = default;
+	inline ~work_stealing_queue() { clear(); }
+
+public:
+	inline bool empty() const;
+	inline std::size_t size() const;
+
+	inline void clear();
+	inline bool pop(type& value);
+	inline bool steal(type& value);
+
+	template <typename... arguments>
+	inline void emplace(arguments&&... parameters);
+
+	// Adds amount elements returned by successive make_element() calls under one lock.
+	template <typename factory_t>
+	inline void emplace_batch(const std::size_t amount, factory_t& make_element);
+
+public:
+	inline work_stealing_queue(const work_stealing_queue& other) = delete;
+	inline work_stealing_queue(work_stealing_queue&& other) = delete;
+	inline work_stealing_queue& operator=(const work_stealing_queue& rhs) = delete;
+	inline work_stealing_queue& operator=(work_stealing_queue&& rhs) = delete;
+
+private:
+	mutable std::mutex m_mutex;
+	work_stealing_queue_implementation m_deque;
+};
+
+
+template <typename type>
+bool work_stealing_queue<type>::empty() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_deque.empty();
+}
+
+template <typename type>
+std::size_t work_stealing_queue<type>::size() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_deque.size();
+}
+
+template <typename type>
+void work_stealing_queue<type>::clear() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_deque.clear();
+}
+
+template <typename type>
+bool work_stealing_queue<type>::pop(type& value) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_deque.empty()) {
+		return false;
+	}
+	else {
+		value = std::move(m_deque.front());
+		m_deque.pop_front();
+		return true;
+	}
+}
+
+template <typename type>
+bool work_stealing_queue<type>::steal(type& value) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_deque.empty()) {
+		return false;
+	}
+	else {
+		value = std::move(m_deque.back());
+		m_deque.pop_back();
+		return true;
+	}
+}
+
+template <typename type>
+template <typename... arguments>
+void work_stealing_queue<type>::emplace(arguments&&... parameters) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_deque.emplace_back(std::forward<arguments>(parameters)...);
+}
+
+template <typename type>
+template <typename factory_t>
+void work_stealing_queue<type>::emplace_batch(const std::size_t amount, factory_t& make_element) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (std::size_t i = 0; i < amount; ++i) {
+		m_deque.emplace_back(make_element());
+	}
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <queue>
+#include <shared_mutex>
+#include <thread>
+
+#include "concurrent_queue.h"
+#include "unique_task.h"
+
+// Number of calls of the global operator new. Counted by the replacement operators defined in main.cpp.
+inline std::atomic<std::size_t> allocations_counter = 0;
+
+// The original concurrent_queue (std::queue over std::deque behind a reader/writer lock) - the "before" baseline.
+template <typename type>
+class deque_concurrent_queue {
+public:
+	inline bool pop(type& value) {
+		write_lock w_lock(m_rw_lock);
+
+		if (m_queue.empty()) {
+			return false;
+		}
+
+		value = std::move(m_queue.front());
+		m_queue.pop();
+		return true;
+	}
+
+	template <typename... arguments>
+	inline void emplace(arguments&&... parameters) {
+		write_lock w_lock(m_rw_lock);
+		m_queue.emplace(std::forward<arguments>(parameters)...);
+	}
+
+private:
+	mutable read_write_lock	m_rw_lock;
+	std::queue<type>		m_queue;
+};
+
+// Stand-in for http_server: the benchmark enqueues the same kind of task as Lab5's main - a const member function, an object pointer and a socket.
+struct benchmark_server {
+	inline void serve_client(const std::uintptr_t client_socket) const { m_served += client_socket; }
+
+	mutable std::uintptr_t m_served = 0;
+};
+
+// A task too big for the inline buffer of unique_task - goes to task_memory_pool.
+struct large_benchmark_task {
+	inline void operator()() { m_served->fetch_add(m_payload[0] + m_payload[m_payload.size() - 1], std::memory_order_relaxed); }
+
+	std::array<std::uintptr_t, 24>	m_payload;
+	std::atomic<std::uintptr_t>*	m_served;
+};
+
+// Enqueues tasks_amount tasks from the current thread while another thread pops and runs them (the thread_pool's add_task/routine flow).
+template <typename task_t, typename queue_t, typename enqueue_t>
+inline void run_tasks_through_queue(queue_t& tasks, const std::size_t tasks_amount, enqueue_t& enqueue) {
+	std::thread consumer([&tasks, tasks_amount] {
+		task_t task;
+		std::size_t completed = 0;
+
+		while (completed < tasks_amount) {
+			if (tasks.pop(task)) {
+				task();
+				++completed;
+			}
+		}
+	});
+
+	for (std::size_t i = 0; i < tasks_amount; ++i) {
+		enqueue(tasks, i);
+	}
+
+	consumer.join();
+}
+
+// Prints how many heap allocations (and how much time) one task costs on its way through the queue, after a warm-up round
+// that lets the queue storage and task_memory_pool reach their steady-state size.
+template <typename task_t, typename queue_t, typename enqueue_t>
+inline void run_allocation_benchmark(const char* name, const std::size_t tasks_amount, enqueue_t enqueue) {
+	queue_t tasks;
+
+	run_tasks_through_queue<task_t>(tasks, tasks_amount, enqueue);
+
+	const std::size_t allocations_before = allocations_counter.load();
+	auto start = std::chrono::high_resolution_clock::now();
+
+	run_tasks_through_queue<task_t>(tasks, tasks_amount, enqueue);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	const std::size_t allocations = allocations_counter.load() - allocations_before;
+	const auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+	std::printf("%-58s: %8.4f allocations per task, %8.1f ns per task.\n", name, static_cast<double>(allocations) / tasks_amount, static_cast<double>(elapsed_ns) / tasks_amount);
+}
+
+inline void run_allocation_benchmarks(const std::size_t tasks_amount) {
+	benchmark_server server;
+	std::atomic<std::uintptr_t> served = 0;
+
+	std::printf("=== Allocations per task (%zu tasks) ===\n", tasks_amount);
+
+	run_allocation_benchmark<std::function<void()>, deque_concurrent_queue<std::function<void()>>>("before: std::bind + std::function, std::deque queue", tasks_amount, [&server](auto& tasks, std::size_t i) {
+		auto bind = std::bind(&benchmark_server::serve_client, &server, static_cast<std::uintptr_t>(i));
+		tasks.emplace(bind);
+	});
+
+	run_allocation_benchmark<std::function<void()>, concurrent_queue<std::function<void()>>>("std::bind + std::function, circular_buffer queue", tasks_amount, [&server](auto& tasks, std::size_t i) {
+		auto bind = std::bind(&benchmark_server::serve_client, &server, static_cast<std::uintptr_t>(i));
+		tasks.emplace(bind);
+	});
+
+	run_allocation_benchmark<unique_task, concurrent_queue<unique_task>>("after: unique_task (inline), circular_buffer queue", tasks_amount, [&server](auto& tasks, std::size_t i) {
+		tasks.emplace(&benchmark_server::serve_client, &server, static_cast<std::uintptr_t>(i));
+	});
+
+	run_allocation_benchmark<std::function<void()>, deque_concurrent_queue<std::function<void()>>>("before: large callable in std::function, std::deque queue", tasks_amount, [&served](auto& tasks, std::size_t i) {
+		large_benchmark_task task{ {}, &served };
+		task.m_payload[0] = i;
+		tasks.emplace(task);
+	});
+
+	run_allocation_benchmark<unique_task, concurrent_queue<unique_task>>("after: large callable in unique_task (task_memory_pool)", tasks_amount, [&served](auto& tasks, std::size_t i) {
+		large_benchmark_task task{ {}, &served };
+		task.m_payload[0] = i;
+		tasks.emplace(std::move(task));
+	});
+}
\ No newline at end of file
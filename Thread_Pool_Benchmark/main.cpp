@@ -0,0 +1,101 @@
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "allocation_benchmark.h"
+#include "pool_benchmark.h"
+
+// Replacement global allocation functions: count every heap allocation made by the benchmarks.
+// The deletes aren't inlined: GCC would see free() called on the pointer of an operator new call and warn (-Wmismatched-new-delete).
+#ifdef _MSC_VER
+#define BENCHMARK_NOINLINE __declspec(noinline)
+#else
+#define BENCHMARK_NOINLINE __attribute__((noinline))
+#endif
+
+void* operator new(std::size_t size) {
+	++allocations_counter;
+
+	if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+BENCHMARK_NOINLINE void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+BENCHMARK_NOINLINE void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+// Over-aligned types (e.g. callables unique_task stores outside of its pool, see unique_task.h) come here.
+void* operator new(std::size_t size, const std::align_val_t alignment) {
+	++allocations_counter;
+
+	const std::size_t alignment_size = static_cast<std::size_t>(alignment);
+#ifdef _MSC_VER
+	void* const memory = _aligned_malloc(size == 0 ? 1 : size, alignment_size);
+#else
+	// aligned_alloc takes only multiples of the alignment.
+	void* const memory = std::aligned_alloc(alignment_size, (size + alignment_size - 1) / alignment_size * alignment_size + (size == 0 ? alignment_size : 0));
+#endif
+	if (memory != nullptr) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+BENCHMARK_NOINLINE void operator delete(void* memory, const std::align_val_t) noexcept {
+#ifdef _MSC_VER
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+BENCHMARK_NOINLINE void operator delete(void* memory, std::size_t, const std::align_val_t alignment) noexcept {
+	operator delete(memory, alignment);
+}
+
+int main(int argc, char* argv[]) {
+	constexpr std::size_t tasks_amount = 1'000'000;
+
+	// Thread_Pool_Benchmark [--quick] [--csv <file>] [--json <file>]
+	bool quick = false;
+	std::string csv_path;
+	std::string json_path;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string argument = argv[i];
+
+		if (argument == "--quick") {
+			quick = true;
+		}
+		else if (argument == "--csv" && i + 1 < argc) {
+			csv_path = argv[++i];
+		}
+		else if (argument == "--json" && i + 1 < argc) {
+			json_path = argv[++i];
+		}
+		else {
+			std::printf("Usage: %s [--quick] [--csv <file>] [--json <file>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	run_allocation_benchmarks(quick ? tasks_amount / 10 : tasks_amount);
+
+	const std::vector<pool_benchmark_result> results = run_pool_benchmarks(quick);
+
+	if (!csv_path.empty()) {
+		write_pool_benchmark_csv(csv_path, results);
+	}
+
+	if (!json_path.empty()) {
+		write_pool_benchmark_json(json_path, results);
+	}
+
+	return 0;
+}
\ No newline at end of file
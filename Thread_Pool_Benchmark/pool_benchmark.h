@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.h"
+
+// One point of the pool benchmark grid.
+struct pool_benchmark_case {
+	std::size_t					producers		= 1;	// Threads calling add_task at the same time.
+	std::size_t					workers			= 1;
+	std::chrono::nanoseconds	task_duration	= std::chrono::nanoseconds(0);	// Busy work of every task, 0 - an empty task.
+	std::size_t					tasks_amount	= 0;
+};
+
+struct pool_benchmark_result {
+	const char*				pool				= "";
+	pool_benchmark_case		benchmark_case;
+	double					tasks_per_second	= 0.0;	// From the start of the producers until the pool is idle again.
+
+	latency_summary			submit;			// The add_task call.
+	latency_summary			end_to_end;		// From the add_task call to the end of the task.
+};
+
+// The pools compared.
+// Lab2 - one shared queue, workers parking right away, statistics on. Its timed phases are left out: with them the benchmark
+// would measure the phase interval instead of the pool.
+// Lab5 - the pool of the HTTP server (thread_pool with work stealing and the hybrid wait strategy, see Lab5 main.cpp).
+using lab2_benchmark_pool = basic_thread_pool<pool_policies<fixed_queue<scheduling_mode::shared_queue>, blocking_wait, true>>;
+using lab5_benchmark_pool = thread_pool;
+
+// Tasks of one case run for about this long on all workers together, whatever the task size (within the limits below).
+constexpr std::chrono::milliseconds	pool_benchmark_work_per_case	= std::chrono::milliseconds(250);
+constexpr std::size_t				pool_benchmark_min_tasks		= 2'000;
+constexpr std::size_t				pool_benchmark_max_tasks		= 200'000;
+
+// Runs benchmark_case on a new pool_t(pool_arguments...). Every task stores its own samples, so recording doesn't synchronize
+// producers or workers, and the percentiles are exact.
+template <typename pool_t, typename... pool_arguments>
+inline pool_benchmark_result run_pool_benchmark(const char* pool_name, const pool_benchmark_case& benchmark_case, const pool_arguments&... arguments);
+
+// Runs both pools over producers x workers x task sizes, printing a line per case. quick - a smaller grid, for a smoke test.
+inline std::vector<pool_benchmark_result> run_pool_benchmarks(const bool quick);
+
+inline void write_pool_benchmark_csv(const std::string& path, const std::vector<pool_benchmark_result>& results);
+inline void write_pool_benchmark_json(const std::string& path, const std::vector<pool_benchmark_result>& results);
+
+
+// Busy work instead of sleep_for: the task holds its worker for the whole duration, like a real computation would.
+inline void spin_for(const std::chrono::nanoseconds duration) {
+	if (duration.count() == 0) {
+		return;
+	}
+
+	const auto end = std::chrono::steady_clock::now() + duration;
+	while (std::chrono::steady_clock::now() < end) {
+	}
+}
+
+inline latency_summary summarize_samples(std::vector<std::uint64_t>& samples) {
+	latency_summary summary;
+
+	if (samples.empty()) {
+		return summary;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	std::uint64_t total_ns = 0;
+	for (const std::uint64_t sample : samples) {
+		total_ns += sample;
+	}
+
+	auto quantile = [&samples](const double q) {
+		const std::size_t rank = static_cast<std::size_t>(q * static_cast<double>(samples.size() - 1));
+		return samples[rank];
+	};
+
+	summary.count	= samples.size();
+	summary.mean_ns	= total_ns / samples.size();
+	summary.p50_ns	= quantile(0.5);
+	summary.p90_ns	= quantile(0.9);
+	summary.p99_ns	= quantile(0.99);
+	summary.p999_ns	= quantile(0.999);
+	summary.max_ns	= samples.back();
+
+	return summary;
+}
+
+template <typename pool_t, typename... pool_arguments>
+inline pool_benchmark_result run_pool_benchmark(const char* pool_name, const pool_benchmark_case& benchmark_case, const pool_arguments&... arguments) {
+	using std::chrono::steady_clock;
+
+	auto nanoseconds_since = [](const steady_clock::time_point since) {
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock::now() - since).count());
+	};
+
+	const std::size_t tasks_amount = benchmark_case.tasks_amount;
+	const std::chrono::nanoseconds task_duration = benchmark_case.task_duration;
+
+	std::vector<std::uint64_t> submit_ns(tasks_amount);
+	std::vector<std::uint64_t> end_to_end_ns(tasks_amount);
+
+	pool_t pool(arguments...);
+	pool.initialize(benchmark_case.workers);
+
+	std::atomic<bool> started = false;
+	std::vector<std::thread> producers;
+	producers.reserve(benchmark_case.producers);
+
+	for (std::size_t producer = 0; producer < benchmark_case.producers; ++producer) {
+		producers.emplace_back([&, producer] {
+			while (!started.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+
+			for (std::size_t i = producer; i < tasks_amount; i += benchmark_case.producers) {
+				const steady_clock::time_point submitted = steady_clock::now();
+
+				pool.add_task([&end_to_end_ns, &nanoseconds_since, i, submitted, task_duration] {
+					spin_for(task_duration);
+					end_to_end_ns[i] = nanoseconds_since(submitted);
+				});
+
+				submit_ns[i] = nanoseconds_since(submitted);
+			}
+		});
+	}
+
+	const steady_clock::time_point start = steady_clock::now();
+	started.store(true, std::memory_order_release);
+
+	for (std::thread& producer : producers) {
+		producer.join();
+	}
+
+	pool.wait_idle();
+	const double elapsed_seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+
+	pool.terminate();
+
+	pool_benchmark_result result;
+	result.pool				= pool_name;
+	result.benchmark_case	= benchmark_case;
+	result.tasks_per_second	= static_cast<double>(tasks_amount) / elapsed_seconds;
+	result.submit			= summarize_samples(submit_ns);
+	result.end_to_end		= summarize_samples(end_to_end_ns);
+
+	return result;
+}
+
+inline std::vector<pool_benchmark_result> run_pool_benchmarks(const bool quick) {
+	const std::size_t hardware_threads = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 4;
+
+	std::vector<std::size_t> producer_counts = { 1, 4 };
+	std::vector<std::size_t> worker_counts = { 1, 4 };
+	std::vector<std::chrono::nanoseconds> task_durations = { std::chrono::nanoseconds(0), std::chrono::microseconds(1), std::chrono::microseconds(10), std::chrono::microseconds(100) };
+
+	if (hardware_threads != 1 && hardware_threads != 4) {
+		worker_counts.push_back(hardware_threads);
+	}
+
+	if (quick) {
+		producer_counts = { 1 };
+		worker_counts = { 4 };
+		task_durations = { std::chrono::nanoseconds(0), std::chrono::microseconds(10) };
+	}
+
+	std::vector<pool_benchmark_result> results;
+
+	std::printf("\n=== Thread pools (latencies in us) ===\n");
+	std::printf("%-5s %9s %7s %8s %8s %12s %10s %10s %10s %10s %10s\n", "pool", "producers", "workers", "task us", "tasks", "tasks/s",
+		"submit p50", "submit p99", "e2e p50", "e2e p99", "e2e p99.9");
+
+	auto print_result = [](const pool_benchmark_result& result) {
+		std::printf("%-5s %9zu %7zu %8.1f %8zu %12.0f %10.2f %10.2f %10.2f %10.2f %10.2f\n", result.pool,
+			result.benchmark_case.producers, result.benchmark_case.workers, result.benchmark_case.task_duration.count() / 1000.0,
+			result.benchmark_case.tasks_amount, result.tasks_per_second,
+			result.submit.p50_ns / 1000.0, result.submit.p99_ns / 1000.0,
+			result.end_to_end.p50_ns / 1000.0, result.end_to_end.p99_ns / 1000.0, result.end_to_end.p999_ns / 1000.0);
+	};
+
+	for (const std::size_t producers : producer_counts) {
+		for (const std::size_t workers : worker_counts) {
+			for (const std::chrono::nanoseconds task_duration : task_durations) {
+				pool_benchmark_case benchmark_case;
+				benchmark_case.producers		= producers;
+				benchmark_case.workers			= workers;
+				benchmark_case.task_duration	= task_duration;
+
+				// About pool_benchmark_work_per_case of work, so long tasks don't make a case run for minutes.
+				std::size_t tasks_amount = pool_benchmark_max_tasks;
+				if (task_duration.count() > 0) {
+					tasks_amount = static_cast<std::size_t>(std::chrono::nanoseconds(pool_benchmark_work_per_case).count() * workers / task_duration.count());
+					tasks_amount = (tasks_amount < pool_benchmark_min_tasks ? pool_benchmark_min_tasks : tasks_amount);
+					tasks_amount = (tasks_amount > pool_benchmark_max_tasks ? pool_benchmark_max_tasks : tasks_amount);
+				}
+				benchmark_case.tasks_amount = (quick ? tasks_amount / 10 : tasks_amount);
+
+				results.push_back(run_pool_benchmark<lab2_benchmark_pool>("lab2", benchmark_case));
+				print_result(results.back());
+
+				results.push_back(run_pool_benchmark<lab5_benchmark_pool>("lab5", benchmark_case, scheduling_mode::work_stealing, wait_strategy::hybrid()));
+				print_result(results.back());
+			}
+		}
+	}
+
+	return results;
+}
+
+inline void write_pool_benchmark_csv(const std::string& path, const std::vector<pool_benchmark_result>& results) {
+	std::ofstream file(path);
+	file << std::fixed << std::setprecision(1);
+
+	file << "pool,producers,workers,task_ns,tasks,tasks_per_second";
+	for (const char* const latency : { "submit", "end_to_end" }) {
+		file << ',' << latency << "_mean_ns," << latency << "_p50_ns," << latency << "_p90_ns," << latency << "_p99_ns," << latency << "_p999_ns," << latency << "_max_ns";
+	}
+	file << '\n';
+
+	for (const pool_benchmark_result& result : results) {
+		file << result.pool << ',' << result.benchmark_case.producers << ',' << result.benchmark_case.workers << ','
+			<< result.benchmark_case.task_duration.count() << ',' << result.benchmark_case.tasks_amount << ',' << result.tasks_per_second;
+
+		for (const latency_summary* const latency : { &result.submit, &result.end_to_end }) {
+			file << ',' << latency->mean_ns << ',' << latency->p50_ns << ',' << latency->p90_ns << ',' << latency->p99_ns << ',' << latency->p999_ns << ',' << latency->max_ns;
+		}
+		file << '\n';
+	}
+}
+
+inline void write_pool_benchmark_json(const std::string& path, const std::vector<pool_benchmark_result>& results) {
+	std::ofstream file(path);
+	file << std::fixed << std::setprecision(1);
+
+	auto write_latency = [&file](const char* const name, const latency_summary& latency) {
+		file << "\"" << name << "\": { \"mean_ns\": " << latency.mean_ns << ", \"p50_ns\": " << latency.p50_ns << ", \"p90_ns\": " << latency.p90_ns
+			<< ", \"p99_ns\": " << latency.p99_ns << ", \"p999_ns\": " << latency.p999_ns << ", \"max_ns\": " << latency.max_ns << " }";
+	};
+
+	file << "[\n";
+	for (std::size_t i = 0; i < results.size(); ++i) {
+		const pool_benchmark_result& result = results[i];
+
+		file << "  { \"pool\": \"" << result.pool << "\", \"producers\": " << result.benchmark_case.producers << ", \"workers\": " << result.benchmark_case.workers
+			<< ", \"task_ns\": " << result.benchmark_case.task_duration.count() << ", \"tasks\": " << result.benchmark_case.tasks_amount
+			<< ", \"tasks_per_second\": " << result.tasks_per_second << ", ";
+		write_latency("submit", result.submit);
+		file << ", ";
+		write_latency("end_to_end", result.end_to_end);
+		file << (i + 1 < results.size() ? " },\n" : " }\n");
+	}
+	file << "]\n";
+}
\ No newline at end of file